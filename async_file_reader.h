@@ -0,0 +1,430 @@
+// Batched asynchronous file reads (Linux).
+//
+// AsyncFileReader queues reads and hands them to the kernel in batches through
+// io_uring: one io_uring_enter submits a whole batch, and completions are
+// reaped from shared memory without a system call each. Where io_uring isn't
+// available (old kernel, seccomp filter) the same interface is served by a
+// small pool of threads calling pread.
+//
+// Either way, completion callbacks run on the thread that calls poll() or
+// wait(), and they're InplaceFunctions, so a read costs no allocation. At most
+// queueDepth reads are in flight; read() drains completions when it runs out
+// of slots.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "inplace_function.h"
+
+class AsyncFileReader
+{
+public:
+    // receives the number of bytes read, or -errno
+    using Callback = InplaceFunction<void(long), 48>;
+
+    enum class Backend
+    {
+        Auto, // io_uring if the kernel lets us, threads otherwise
+        IoUring,
+        Threads
+    };
+
+    explicit AsyncFileReader(unsigned queueDepth = 256, Backend backend = Backend::Auto,
+                             unsigned threads = 4)
+        : slots(queueDepth)
+    {
+        freeSlots.reserve(queueDepth);
+        for (unsigned i = queueDepth; i-- != 0;)
+            freeSlots.push_back(i);
+        queued.reserve(queueDepth);
+
+        if (backend != Backend::Threads && setupRing(queueDepth))
+            return;
+        if (backend == Backend::IoUring)
+            throw std::system_error(ringError, std::generic_category(), "io_uring_setup");
+
+        startWorkers(threads);
+    }
+
+    AsyncFileReader(const AsyncFileReader &) = delete;
+    AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+    ~AsyncFileReader()
+    {
+        // a destructor mustn't throw: if io_uring_enter or a callback does,
+        // the reads left are drained without their callbacks
+        try
+        {
+            wait();
+        }
+        catch (...)
+        {
+            drain();
+        }
+
+        if (ringFd >= 0)
+        {
+            ::munmap(sqes, sqesSize);
+            if (cqRing != sqRing)
+                ::munmap(cqRing, cqRingSize);
+            ::munmap(sqRing, sqRingSize);
+            ::close(ringFd);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(m);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+
+    bool usingIoUring() const noexcept { return ringFd >= 0; }
+
+    // queues a read of len bytes at offset into buf; cb runs once it's done
+    void read(int fd, void *buf, std::size_t len, std::uint64_t offset, Callback cb)
+    {
+        while (freeSlots.empty())
+            reap(true);
+
+        unsigned idx = freeSlots.back();
+        freeSlots.pop_back();
+
+        Slot &slot = slots[idx];
+        slot.fd = fd;
+        slot.iov.iov_base = buf;
+        slot.iov.iov_len = len;
+        slot.offset = offset;
+        slot.callback = std::move(cb);
+        queued.push_back(idx);
+        ++inFlight;
+
+        if (queued.size() >= batchSize)
+            submit();
+    }
+
+    // hands every queued read to the kernel (or the workers) in one go
+    void submit()
+    {
+        if (queued.empty())
+            return;
+
+        if (usingIoUring())
+            submitToRing(); // clears queued once the reads are in the ring
+        else
+        {
+            submitToWorkers();
+            queued.clear();
+        }
+    }
+
+    // runs callbacks of reads that have completed; never blocks
+    std::size_t poll() { return reap(false); }
+
+    // submits and runs callbacks until nothing is in flight
+    void wait()
+    {
+        while (inFlight != 0)
+            reap(true);
+    }
+
+    void setBatchSize(std::size_t n) noexcept { batchSize = n ? n : 1; }
+
+private:
+    struct Slot
+    {
+        int fd = -1;
+        iovec iov{};
+        std::uint64_t offset = 0;
+        long result = 0;
+        Callback callback;
+    };
+
+    std::size_t reap(bool block)
+    {
+        submit();
+        if (inFlight == 0)
+            return 0;
+
+        return usingIoUring() ? reapRing(block) : reapWorkers(block);
+    }
+
+    // Drops the reads that never left this object, and waits for the ones
+    // the kernel may still be filling in, without running any callbacks;
+    // the workers finish theirs before they're joined.
+    void drain() noexcept
+    {
+        for (unsigned idx : queued)
+            freeSlots.push_back(idx);
+        inFlight -= queued.size();
+        queued.clear();
+        if (!usingIoUring())
+            return;
+
+        unsigned head = cqHead->load(std::memory_order_relaxed);
+        while (inFlight != 0)
+        {
+            if (head != cqTail->load(std::memory_order_acquire))
+            {
+                cqHead->store(++head, std::memory_order_release);
+                --inFlight;
+                continue;
+            }
+            // entries still in the submission ring go in with this call
+            unsigned unsubmitted = sqTail->load(std::memory_order_relaxed) - sqHead->load(std::memory_order_acquire);
+            if (ioUringEnter(unsubmitted, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR &&
+                errno != EAGAIN && errno != EBUSY)
+                return; // the ring is broken: nothing more to wait for
+        }
+    }
+
+    void complete(unsigned idx, long result)
+    {
+        Slot &slot = slots[idx];
+        auto cb = std::move(slot.callback);
+        freeSlots.push_back(idx);
+        --inFlight;
+        cb(result); // may queue more reads, slot is already free
+    }
+
+    // io_uring backend --------------------------------------------------
+
+    static int ioUringSetup(unsigned entries, io_uring_params *p)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    int ioUringEnter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return static_cast<int>(
+            ::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    bool setupRing(unsigned entries)
+    {
+        io_uring_params p{};
+        ringFd = ioUringSetup(entries, &p);
+        if (ringFd < 0)
+        {
+            ringError = errno;
+            return false;
+        }
+
+        sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        auto map = [this](std::size_t size, off_t what)
+        {
+            return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, what);
+        };
+        sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+        cqRing = singleMmap ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+        sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqesMem = map(sqesSize, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqesMem == MAP_FAILED)
+        {
+            ringError = errno;
+            if (sqesMem != MAP_FAILED)
+                ::munmap(sqesMem, sqesSize);
+            if (cqRing != MAP_FAILED && cqRing != sqRing)
+                ::munmap(cqRing, cqRingSize);
+            if (sqRing != MAP_FAILED)
+                ::munmap(sqRing, sqRingSize);
+            ::close(ringFd);
+            ringFd = -1;
+            return false;
+        }
+
+        auto at = [](void *base, unsigned off)
+        { return static_cast<char *>(base) + off; };
+        sqHead = reinterpret_cast<std::atomic<unsigned> *>(at(sqRing, p.sq_off.head));
+        sqTail = reinterpret_cast<std::atomic<unsigned> *>(at(sqRing, p.sq_off.tail));
+        sqMask = *reinterpret_cast<unsigned *>(at(sqRing, p.sq_off.ring_mask));
+        sqArray = reinterpret_cast<unsigned *>(at(sqRing, p.sq_off.array));
+        cqHead = reinterpret_cast<std::atomic<unsigned> *>(at(cqRing, p.cq_off.head));
+        cqTail = reinterpret_cast<std::atomic<unsigned> *>(at(cqRing, p.cq_off.tail));
+        cqMask = *reinterpret_cast<unsigned *>(at(cqRing, p.cq_off.ring_mask));
+        cqes = reinterpret_cast<io_uring_cqe *>(at(cqRing, p.cq_off.cqes));
+        sqes = static_cast<io_uring_sqe *>(sqesMem);
+        return true;
+    }
+
+    void submitToRing()
+    {
+        // in-flight reads never exceed queueDepth <= sq_entries, so there's
+        // always room; only this thread writes the tail
+        unsigned tail = sqTail->load(std::memory_order_relaxed);
+        for (unsigned idx : queued)
+        {
+            const Slot &slot = slots[idx];
+            unsigned pos = tail++ & sqMask;
+
+            io_uring_sqe &sqe = sqes[pos];
+            sqe = io_uring_sqe{};
+            sqe.opcode = IORING_OP_READV; // READV works back to 5.1
+            sqe.fd = slot.fd;
+            sqe.off = slot.offset;
+            sqe.addr = reinterpret_cast<std::uint64_t>(&slot.iov);
+            sqe.len = 1;
+            sqe.user_data = idx;
+            sqArray[pos] = pos;
+        }
+        sqTail->store(tail, std::memory_order_release);
+        auto left = static_cast<unsigned>(queued.size());
+        queued.clear();
+
+        while (left != 0)
+        {
+            int n = ioUringEnter(left, 0, 0);
+            if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            if (n > 0)
+                left -= n;
+        }
+    }
+
+    std::size_t reapRing(bool block)
+    {
+        unsigned head = cqHead->load(std::memory_order_relaxed);
+        if (block && head == cqTail->load(std::memory_order_acquire))
+        {
+            while (ioUringEnter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno == EINTR)
+            {
+            }
+        }
+
+        std::size_t done = 0;
+        for (;;)
+        {
+            unsigned tail = cqTail->load(std::memory_order_acquire);
+            if (head == tail)
+                break;
+
+            const io_uring_cqe &cqe = cqes[head & cqMask];
+            auto idx = static_cast<unsigned>(cqe.user_data);
+            long result = cqe.res;
+            cqHead->store(++head, std::memory_order_release);
+
+            complete(idx, result);
+            ++done;
+        }
+        return done;
+    }
+
+    // thread backend -----------------------------------------------------
+
+    void startWorkers(unsigned threads)
+    {
+        workQueue.reserve(slots.size());
+        completed.reserve(slots.size());
+        for (unsigned i = 0; i != threads; ++i)
+            workers.emplace_back([this]
+                                 { workerLoop(); });
+    }
+
+    void submitToWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m);
+            workQueue.insert(workQueue.end(), queued.begin(), queued.end());
+        }
+        workAvailable.notify_all();
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m);
+        for (;;)
+        {
+            workAvailable.wait(lock, [this]
+                               { return stopping || !workQueue.empty(); });
+            if (workQueue.empty())
+                return;
+
+            unsigned idx = workQueue.back();
+            workQueue.pop_back();
+            lock.unlock();
+
+            Slot &slot = slots[idx];
+            auto n = ::pread(slot.fd, slot.iov.iov_base, slot.iov.iov_len,
+                             static_cast<off_t>(slot.offset));
+            slot.result = n < 0 ? -errno : n;
+
+            lock.lock();
+            completed.push_back(idx);
+            readsDone.notify_one();
+        }
+    }
+
+    // one completion at a time, since a callback may call read() and reap
+    // again from inside this loop
+    std::size_t reapWorkers(bool block)
+    {
+        std::size_t done = 0;
+        for (;;)
+        {
+            unsigned idx;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                if (block && done == 0)
+                    readsDone.wait(lock, [this]
+                                   { return !completed.empty(); });
+                if (completed.empty())
+                    return done;
+                idx = completed.back();
+                completed.pop_back();
+            }
+
+            complete(idx, slots[idx].result);
+            ++done;
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<unsigned> freeSlots; // owned by the caller's thread
+    std::vector<unsigned> queued;    // read() but not yet submitted
+    std::size_t inFlight = 0;
+    std::size_t batchSize = 32;
+
+    int ringFd = -1;
+    int ringError = 0;
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    std::size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+    std::atomic<unsigned> *sqHead = nullptr; // advanced by the kernel
+    std::atomic<unsigned> *sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned *sqArray = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    std::atomic<unsigned> *cqHead = nullptr;
+    std::atomic<unsigned> *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+
+    std::mutex m;
+    std::condition_variable workAvailable, readsDone;
+    std::vector<unsigned> workQueue, completed;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
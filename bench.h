@@ -0,0 +1,46 @@
+// Tiny timing helpers shared by the benchmark sections of the item demos.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// keeps the optimizer from throwing away a value we computed only to time it
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+// wall-clock nanoseconds spent in f()
+template <typename F>
+double measureNs(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+// runs f(threadIndex) on `threads` threads at once and returns the wall-clock
+// nanoseconds until the last one finished
+template <typename F>
+double runOnThreads(unsigned threads, F f)
+{
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    return measureNs([&]
+                     {
+        for (unsigned i = 0; i != threads; ++i)
+            workers.emplace_back(f, i);
+        for (auto &t : workers)
+            t.join(); });
+}
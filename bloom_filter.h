@@ -0,0 +1,186 @@
+// Blocked Bloom filter.
+//
+// mayContain(key) is false only if key was never inserted; true means
+// "probably", wrong at about the false-positive rate the filter was sized
+// for. Each key maps to one 32-byte block, aligned so that it never
+// straddles a cache line, and sets one bit in each of the block's eight
+// 32-bit words. A probe therefore touches one cache line, and with SSE2 it
+// builds all eight masks and tests the block in a handful of instructions
+// (this is the split-block filter of Parquet and Impala).
+//
+// Blocks fill unevenly, so a blocked filter needs somewhat more bits per key
+// than a classic one for the same rate; the constructor works out how many.
+// A Bloom filter can't forget a key: when keys go away, or more than
+// `expected` have been inserted (saturated()), build a new one and swap it
+// in.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define BLOOM_SSE2 1
+#endif
+
+namespace detail
+{
+    // odd multipliers, one per word of a block
+    alignas(16) constexpr std::uint32_t kBloomSalts[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                                                          0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                                                          0x9efc4947U, 0x5c6bfb31U};
+
+    // the rate at bitsPerKey: a block holding j keys says yes to another
+    // with probability (1 - (31/32)^j)^8, and j is Poisson distributed with
+    // mean 256 / bitsPerKey
+    inline double blockedBloomFpr(double bitsPerKey)
+    {
+        double mean = 256 / bitsPerKey, p = std::exp(-mean), fpr = 0;
+        for (int j = 0; j < mean * 4 + 64; ++j)
+        {
+            fpr += p * std::pow(1 - std::pow(31.0 / 32, j), 8);
+            p *= mean / (j + 1);
+        }
+        return fpr;
+    }
+
+    struct FreeDeleter
+    {
+        void operator()(void *p) const noexcept { std::free(p); }
+    };
+}
+
+class BlockedBloomFilter
+{
+public:
+    // room for expected keys at false-positive rate fpr
+    BlockedBloomFilter(std::size_t expected, double fpr) : expected(expected)
+    {
+        double bitsPerKey = 4;
+        while (bitsPerKey < 64 && detail::blockedBloomFpr(bitsPerKey) > fpr)
+            bitsPerKey += 0.25;
+        blockCount = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(expected * bitsPerKey / 256)));
+
+        void *p = nullptr;
+        if (::posix_memalign(&p, 64, blockCount * sizeof(Block)) != 0)
+            throw std::bad_alloc();
+        blocks.reset(static_cast<Block *>(p));
+        clear();
+    }
+
+    void insert(std::uint64_t key) noexcept
+    {
+        std::uint64_t h = hash(key);
+        Block &b = blocks[blockOf(h)];
+#if defined(BLOOM_SSE2)
+        __m128i lo, hi;
+        masks(static_cast<std::uint32_t>(h), lo, hi);
+        auto *words = reinterpret_cast<__m128i *>(b.words);
+        _mm_store_si128(words, _mm_or_si128(_mm_load_si128(words), lo));
+        _mm_store_si128(words + 1, _mm_or_si128(_mm_load_si128(words + 1), hi));
+#else
+        for (unsigned i = 0; i != 8; ++i)
+            b.words[i] |= mask(static_cast<std::uint32_t>(h), i);
+#endif
+        ++count;
+    }
+
+    bool mayContain(std::uint64_t key) const noexcept
+    {
+        std::uint64_t h = hash(key);
+        const Block &b = blocks[blockOf(h)];
+#if defined(BLOOM_SSE2)
+        __m128i lo, hi;
+        masks(static_cast<std::uint32_t>(h), lo, hi);
+        auto *words = reinterpret_cast<const __m128i *>(b.words);
+        // the mask bits missing from the block, if any
+        __m128i missing = _mm_or_si128(_mm_andnot_si128(_mm_load_si128(words), lo),
+                                       _mm_andnot_si128(_mm_load_si128(words + 1), hi));
+        return _mm_movemask_epi8(_mm_cmpeq_epi32(missing, _mm_setzero_si128())) == 0xFFFF;
+#else
+        for (unsigned i = 0; i != 8; ++i)
+            if (!(b.words[i] & mask(static_cast<std::uint32_t>(h), i)))
+                return false;
+        return true;
+#endif
+    }
+
+    void clear() noexcept
+    {
+        std::memset(blocks.get(), 0, blockCount * sizeof(Block));
+        count = 0;
+    }
+
+    std::size_t size() const noexcept { return count; } // insertions, duplicates included
+    std::size_t bytes() const noexcept { return blockCount * sizeof(Block); }
+    bool saturated() const noexcept { return count > expected; }
+
+private:
+    struct Block
+    {
+        alignas(32) std::uint32_t words[8];
+    };
+
+    // murmur3's finalizer: the top half picks the block, the bottom half
+    // the bits
+    static std::uint64_t hash(std::uint64_t x) noexcept
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    std::size_t blockOf(std::uint64_t h) const noexcept
+    {
+        return static_cast<std::size_t>(((h >> 32) * blockCount) >> 32);
+    }
+
+#if defined(BLOOM_SSE2)
+    // SSE2 has no 32-bit multiply that keeps the low halves (pmulld is
+    // SSE4.1): multiply the even and odd lanes separately, and interleave
+    static __m128i mullo(__m128i a, __m128i b) noexcept
+    {
+        __m128i even = _mm_mul_epu32(a, b);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    // 1 << x in every lane, for x in [0, 32), without a per-lane shift (that's
+    // AVX2): build the float 2^x from its exponent, and convert it. 2^31
+    // overflows to 0x80000000, which happens to be 1 << 31.
+    static __m128i powersOfTwo(__m128i x) noexcept
+    {
+        __m128i f = _mm_slli_epi32(_mm_add_epi32(x, _mm_set1_epi32(127)), 23);
+        return _mm_cvttps_epi32(_mm_castsi128_ps(f));
+    }
+
+    static void masks(std::uint32_t h, __m128i &lo, __m128i &hi) noexcept
+    {
+        __m128i key = _mm_set1_epi32(static_cast<int>(h));
+        auto *salts = reinterpret_cast<const __m128i *>(detail::kBloomSalts);
+        lo = powersOfTwo(_mm_srli_epi32(mullo(key, _mm_load_si128(salts)), 27));
+        hi = powersOfTwo(_mm_srli_epi32(mullo(key, _mm_load_si128(salts + 1)), 27));
+    }
+#else
+    static std::uint32_t mask(std::uint32_t h, unsigned i) noexcept
+    {
+        return std::uint32_t(1) << ((h * detail::kBloomSalts[i]) >> 27);
+    }
+#endif
+
+    std::unique_ptr<Block[], detail::FreeDeleter> blocks;
+    std::size_t blockCount;
+    std::size_t expected;
+    std::size_t count = 0;
+};
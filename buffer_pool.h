@@ -0,0 +1,242 @@
+// Recycling pool for std::vector buffers.
+//
+// A vector that's used once and destroyed gives its memory back to malloc, and
+// the next one of the same size pays for the allocation (and, for big buffers,
+// fresh page faults) all over again. BufferPool<T> keeps released buffers
+// around, emptied but with their capacity, and hands them out again.
+//
+// Each thread has a small cache of its own; a full cache spills half of its
+// buffers to a shared, mutex-protected list, and a thread's leftovers move
+// there when it exits. Trimming: buffers above maxCapacity elements are never
+// kept, both lists are bounded, and trim() drops everything cached.
+//
+// PooledVector<T> is a std::vector<T> that takes its buffer from the pool and
+// returns it when destroyed, so moving one along a chain of rvalues (see
+// Item 12's data() &&) reuses the same storage from start to end.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct BufferPoolLimits
+{
+    std::size_t perThread = 8;         // buffers cached by each thread
+    std::size_t shared = 64;           // buffers on the shared list
+    std::size_t maxCapacity = 1 << 24; // elements; bigger buffers are freed
+};
+
+template <typename T>
+class BufferPool
+{
+public:
+    using Buffer = std::vector<T>;
+
+    // one pool per element type; leaked, so buffers may be released at any
+    // point of static or thread-local destruction (once the thread's cache
+    // is gone, they go straight to the shared list)
+    static BufferPool &instance()
+    {
+        static BufferPool *pool = new BufferPool;
+        return *pool;
+    }
+
+    // an empty buffer with room for at least minCapacity elements
+    Buffer acquire(std::size_t minCapacity)
+    {
+        Buffer result;
+        LocalCache *cache = local();
+        if (cache && takeFrom(cache->buffers, minCapacity, result))
+            return result;
+
+        {
+            std::lock_guard<std::mutex> guard(m);
+            if (takeFrom(sharedBuffers, minCapacity, result))
+                return result;
+        }
+
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        result.reserve(minCapacity);
+        return result;
+    }
+
+    void release(Buffer &&buf) noexcept
+    {
+        if (buf.capacity() == 0 || buf.capacity() > limits.maxCapacity)
+            return;
+        buf.clear();
+
+        LocalCache *cache = nullptr;
+        try
+        {
+            cache = local();
+        }
+        catch (...) // the thread's cache couldn't be set up;
+        {           // the buffer is simply freed
+            return;
+        }
+
+        if (!cache)
+        {
+            std::lock_guard<std::mutex> guard(m);
+            if (sharedBuffers.size() < limits.shared)
+                sharedBuffers.push_back(std::move(buf)); // reserved: can't throw
+            return;
+        }
+
+        auto &buffers = cache->buffers;
+        if (buffers.size() == limits.perThread)
+            spill(buffers, limits.perThread / 2);
+        if (buffers.size() < limits.perThread)
+            buffers.push_back(std::move(buf));
+    }
+
+    // frees every cached buffer (the calling thread's and the shared ones)
+    void trim() noexcept
+    {
+        if (LocalCache *cache = localState().cache)
+            cache->buffers.clear();
+        std::lock_guard<std::mutex> guard(m);
+        sharedBuffers.clear();
+    }
+
+    // not thread-safe: set limits before the pool is in use
+    void setLimits(const BufferPoolLimits &l) { limits = l; }
+
+    std::size_t hits() const noexcept { return hitCount; }
+    std::size_t misses() const noexcept { return missCount; }
+
+private:
+    struct LocalCache
+    {
+        std::vector<Buffer> buffers;
+
+        LocalCache() { buffers.reserve(instance().limits.perThread); }
+
+        ~LocalCache()
+        {
+            instance().spill(buffers, buffers.size());
+            localState() = LocalState{nullptr, true};
+        }
+    };
+
+    // trivially destructible, so it can still be read once the thread's
+    // LocalCache has been destroyed, e.g. from a later thread_local or
+    // static destructor
+    struct LocalState
+    {
+        LocalCache *cache;
+        bool destroyed;
+    };
+
+    static LocalState &localState() noexcept
+    {
+        static thread_local LocalState state{nullptr, false};
+        return state;
+    }
+
+    // the thread's cache, set up on first use; null once it's been destroyed
+    static LocalCache *local()
+    {
+        LocalState &state = localState();
+        if (!state.cache && !state.destroyed)
+        {
+            static thread_local LocalCache cache;
+            state.cache = &cache;
+        }
+        return state.cache;
+    }
+
+    BufferPool() { sharedBuffers.reserve(limits.shared); }
+
+    bool takeFrom(std::vector<Buffer> &buffers, std::size_t minCapacity, Buffer &result) noexcept
+    {
+        for (auto &buf : buffers)
+        {
+            if (buf.capacity() >= minCapacity)
+            {
+                std::swap(buf, buffers.back());
+                result = std::move(buffers.back());
+                buffers.pop_back();
+                hitCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // moves up to n buffers from cache to the shared list; the rest of
+    // those n are freed if the shared list is full
+    void spill(std::vector<Buffer> &cache, std::size_t n) noexcept
+    {
+        std::lock_guard<std::mutex> guard(m);
+        for (; n != 0; --n)
+        {
+            if (sharedBuffers.size() < limits.shared)
+                sharedBuffers.push_back(std::move(cache.back()));
+            cache.pop_back();
+        }
+    }
+
+    BufferPoolLimits limits;
+    std::mutex m;
+    std::vector<Buffer> sharedBuffers;
+    std::atomic<std::size_t> hitCount{0}, missCount{0};
+};
+
+// A std::vector whose buffer comes from, and goes back to, BufferPool<T>.
+// Inheriting keeps the whole vector interface; PooledVector adds no data
+// members, so nothing is lost if one is handled as a plain std::vector.
+template <typename T>
+class PooledVector : public std::vector<T>
+{
+    using Base = std::vector<T>;
+
+public:
+    PooledVector() noexcept = default;
+
+    // empty, with room for at least n elements (a named function, because
+    // PooledVector(n) would read like std::vector's n-element constructor)
+    static PooledVector withCapacity(std::size_t n)
+    {
+        return PooledVector(BufferPool<T>::instance().acquire(n));
+    }
+
+    PooledVector(const PooledVector &rhs) : PooledVector(withCapacity(rhs.size()))
+    {
+        this->assign(rhs.begin(), rhs.end());
+    }
+
+    // std::vector's move constructor leaves rhs empty, so rhs's destructor
+    // has nothing to give back
+    PooledVector(PooledVector &&rhs) noexcept = default;
+
+    PooledVector &operator=(const PooledVector &rhs)
+    {
+        this->assign(rhs.begin(), rhs.end());
+        return *this;
+    }
+
+    PooledVector &operator=(PooledVector &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            recycle();
+            Base::operator=(std::move(rhs));
+        }
+        return *this;
+    }
+
+    ~PooledVector() { recycle(); }
+
+private:
+    explicit PooledVector(Base &&buf) noexcept : Base(std::move(buf)) {}
+
+    void recycle() noexcept
+    {
+        BufferPool<T>::instance().release(std::move(*this));
+    }
+};
@@ -0,0 +1,146 @@
+// Binary snapshot of a cache's hot entries, read back through a mapping.
+//
+// CacheSnapshotWriter collects (key, bytes) records and writes them in one
+// file: a header, an index of {key, offset, size} sorted by key, then the
+// records, each 8-byte aligned. The file is written under a temporary name
+// and renamed into place, so a reader never sees half a snapshot.
+//
+// CacheSnapshot maps the file and does nothing else when it opens it, so
+// opening one costs the same for ten entries as for ten million. find()
+// binary-searches the mapped index and returns a view of the record; only
+// the pages it touches are read in. A missing, truncated or foreign file
+// opens as an empty snapshot, because starting cold is always an option.
+//
+//     CacheSnapshot snapshot("cache.snapshot");
+//     ByteSpan bytes = snapshot.find(id); // empty if id wasn't saved
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace detail
+{
+    struct SnapshotHeader
+    {
+        char magic[8];
+        std::uint64_t count; // index entries
+    };
+
+    struct SnapshotEntry
+    {
+        std::uint64_t key;
+        std::uint64_t offset; // from the start of the file
+        std::uint64_t size;
+    };
+
+    constexpr char kSnapshotMagic[8] = {'C', 'S', 'N', 'A', 'P', 0, 0, 1};
+}
+
+class CacheSnapshotWriter
+{
+public:
+    void add(std::uint64_t key, const void *data, std::size_t size)
+    {
+        index.push_back(detail::SnapshotEntry{key, records.size(), size});
+        auto bytes = static_cast<const Byte *>(data);
+        records.insert(records.end(), bytes, bytes + size);
+        records.resize((records.size() + 7) & ~std::size_t(7));
+    }
+
+    std::size_t size() const noexcept { return index.size(); }
+
+    // false if path can't be written; a key added twice keeps its first record
+    bool write(const char *path)
+    {
+        std::stable_sort(index.begin(), index.end(),
+                         [](const detail::SnapshotEntry &a, const detail::SnapshotEntry &b)
+                         { return a.key < b.key; });
+        index.erase(std::unique(index.begin(), index.end(),
+                                [](const detail::SnapshotEntry &a, const detail::SnapshotEntry &b)
+                                { return a.key == b.key; }),
+                    index.end());
+
+        detail::SnapshotHeader header;
+        std::memcpy(header.magic, detail::kSnapshotMagic, sizeof header.magic);
+        header.count = index.size();
+        std::uint64_t base = sizeof header + index.size() * sizeof(detail::SnapshotEntry);
+        std::vector<detail::SnapshotEntry> entries(index);
+        for (auto &e : entries)
+            e.offset += base;
+
+        std::string temporary = std::string(path) + ".tmp";
+        std::FILE *out = std::fopen(temporary.c_str(), "wb");
+        if (!out)
+            return false;
+        bool ok = std::fwrite(&header, sizeof header, 1, out) == 1 &&
+                  std::fwrite(entries.data(), sizeof(detail::SnapshotEntry), entries.size(), out) == entries.size() &&
+                  std::fwrite(records.data(), 1, records.size(), out) == records.size();
+        ok = std::fclose(out) == 0 && ok;
+        if (ok && std::rename(temporary.c_str(), path) == 0)
+            return true;
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+private:
+    std::vector<detail::SnapshotEntry> index; // offsets into records, for now
+    std::vector<Byte> records;
+};
+
+class CacheSnapshot
+{
+public:
+    CacheSnapshot() noexcept = default;
+
+    explicit CacheSnapshot(const char *path)
+    {
+        try
+        {
+            file = MappedFile(path, MappedFile::Access::Random);
+        }
+        catch (const std::system_error &)
+        {
+            return; // no snapshot: a cold start
+        }
+
+        ByteSpan bytes = file.bytes();
+        detail::SnapshotHeader header;
+        if (bytes.size() < sizeof header)
+            return;
+        std::memcpy(&header, bytes.data(), sizeof header);
+        if (std::memcmp(header.magic, detail::kSnapshotMagic, sizeof header.magic) != 0 ||
+            header.count > (bytes.size() - sizeof header) / sizeof(detail::SnapshotEntry))
+            return;
+
+        index = reinterpret_cast<const detail::SnapshotEntry *>(bytes.data() + sizeof header);
+        count = header.count;
+    }
+
+    std::size_t size() const noexcept { return count; }
+
+    ByteSpan find(std::uint64_t key) const noexcept
+    {
+        auto e = std::lower_bound(index, index + count, key,
+                                  [](const detail::SnapshotEntry &e, std::uint64_t key)
+                                  { return e.key < key; });
+        ByteSpan bytes = file.bytes();
+        if (e == index + count || e->key != key || e->offset > bytes.size() ||
+            e->size > bytes.size() - e->offset)
+            return ByteSpan();
+        return bytes.subspan(e->offset, e->size);
+    }
+
+private:
+    MappedFile file;
+    const detail::SnapshotEntry *index = nullptr; // into the mapping
+    std::size_t count = 0;
+};
@@ -1,10 +1,18 @@
 #include <iostream>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "output_sink.h"
 
 void f(int v[2])
 {
+    auto &out = stdoutSink();
     for (int i = 0; i < 10; i++)
-        std ::cout << v[i] << ' ' << v + i << '\n';
-    std ::cout << v << '\n';
+        out << v[i] << ' ' << v + i << '\n';
+    out << v << '\n';
 }
 
 template <typename T, size_t N>
@@ -13,42 +21,89 @@ constexpr size_t arraySize(T (&)[N]) noexcept
     return N;
 }
 
-int main()
+// f()'s line, printed the usual way and through an OutputSink, with stdout
+// sent to /dev/null; `threads` sink writers share the work in the last run
+void benchmarkPrinting(std::size_t lines, unsigned threads)
 {
+    int v[16] = {};
+
+    stdoutSink().flushAll();
+    std ::cout.flush();
+    int saved = ::dup(STDOUT_FILENO);
+    int devNull = ::open("/dev/null", O_WRONLY);
+    ::dup2(devNull, STDOUT_FILENO);
+
+    double coutNs = measureNs([&]
+                              {
+        for (std::size_t i = 0; i != lines; ++i)
+            std ::cout << i << ' ' << v + i % 16 << '\n';
+        std ::cout.flush(); });
+
+    double sinkNs = measureNs([&]
+                              {
+        OutputSink sink(STDOUT_FILENO);
+        for (std::size_t i = 0; i != lines; ++i)
+            sink << i << ' ' << v + i % 16 << '\n'; });
+
+    OutputSink shared(STDOUT_FILENO);
+    double threadedNs = runOnThreads(threads, [&](unsigned t)
+                                     {
+        for (std::size_t i = t; i < lines; i += threads)
+            shared << i << ' ' << v + i % 16 << '\n';
+        shared.flush(); });
+
+    ::dup2(saved, STDOUT_FILENO);
+    ::close(saved);
+    ::close(devNull);
+
+    stdoutSink() << lines << " lines (ns per line): std::cout " << coutNs / lines
+                 << ", OutputSink " << sinkNs / lines << ", OutputSink on " << threads
+                 << " threads " << threadedNs / lines << '\n';
+}
+
+int main(int argc, char *argv[])
+{
+    auto &out = stdoutSink();
+
     int y = 20, z = 100;
     const int *x = &y;
 
     y = 10;
     x = &z;
 
-    std::cout << *x << '\n';
+    out << *x << '\n';
 
     int w[] = {4374, 1345, 43223, 3453, 745, 74};
     int v[] = {1, 2, 3, 4};
 
     // f(v);
 
-    std ::cout << arraySize(w) << ' ' << arraySize(v) << '\n';
+    out << arraySize(w) << ' ' << arraySize(v) << '\n';
 
     auto &&rv = 27;
 
-    std ::cout << rv << '\n';
+    out << rv << '\n';
 
     rv = 100;
 
-    std ::cout << rv << '\n';
+    out << rv << '\n';
 
     rv = y;
 
-    std ::cout << rv << '\n';
+    out << rv << '\n';
 
     for (int i{}; i < 3; i++)
-        std ::cout << i << ' ';
-    std ::cout << '\n';
+        out << i << ' ';
+    out << '\n';
 
     for (int i{}; i < 3; ++i)
-        std ::cout << i << ' ';
-    std ::cout << '\n';
+        out << i << ' ';
+    out << '\n';
+
+    // argv[1] lines (default 10 million; the 100M case takes a while)
+    std::size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    if (lines > 0)
+        benchmarkPrinting(lines, 4);
 
     return 0;
 }
\ No newline at end of file
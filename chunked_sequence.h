@@ -0,0 +1,356 @@
+// Sequence container with O(log n) positional insert.
+//
+// ChunkedSequence<T> is a B+-tree whose leaves are small vectors ("chunks")
+// of up to LeafCapacity elements, chained left to right. Inner nodes keep the
+// element count of each subtree, which is all a positional container needs:
+// reaching the n-th element is a walk down the counts, and inserting shifts
+// at most one chunk and updates one count per level. Iteration runs through
+// the chunks, so it keeps most of std::vector's locality.
+//
+// Like std::vector, it offers cbegin/cend and insert(const_iterator, value),
+// so generic code such as Item 13's findAndInsert works on it unchanged. It
+// lives in namespace seq so that argument-dependent lookup doesn't drag
+// hand-rolled global cbegin/cend templates (Item 13 has one) into the calls.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace seq
+{
+    template <typename T, std::size_t LeafCapacity = 256, std::size_t Fanout = 64>
+    class ChunkedSequence
+    {
+        struct Inner;
+
+        struct Node
+        {
+            explicit Node(bool isLeaf) : isLeaf(isLeaf) {}
+
+            Inner *parent = nullptr;
+            const bool isLeaf;
+        };
+
+        struct Leaf : Node
+        {
+            Leaf() : Node(true) { items.reserve(LeafCapacity + 1); }
+
+            std::vector<T> items;
+            Leaf *prev = nullptr;
+            Leaf *next = nullptr;
+        };
+
+        struct Inner : Node
+        {
+            Inner() : Node(false) {}
+
+            std::vector<Node *> children;
+            std::vector<std::size_t> counts; // elements under each child
+        };
+
+        template <bool Const>
+        class Iter
+        {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<Const, const T *, T *>;
+            using reference = std::conditional_t<Const, const T &, T &>;
+
+            Iter() noexcept = default;
+            Iter(Leaf *leaf, std::size_t index) noexcept : leaf(leaf), index(index) {}
+
+            // iterator -> const_iterator
+            template <bool C = Const, typename = std::enable_if_t<C>>
+            Iter(const Iter<false> &rhs) noexcept : leaf(rhs.leaf), index(rhs.index)
+            {
+            }
+
+            reference operator*() const noexcept { return leaf->items[index]; }
+            pointer operator->() const noexcept { return &leaf->items[index]; }
+
+            Iter &operator++() noexcept
+            {
+                if (++index == leaf->items.size() && leaf->next)
+                {
+                    leaf = leaf->next;
+                    index = 0;
+                }
+                return *this;
+            }
+
+            Iter operator++(int) noexcept
+            {
+                auto old = *this;
+                ++*this;
+                return old;
+            }
+
+            Iter &operator--() noexcept
+            {
+                if (index == 0)
+                {
+                    leaf = leaf->prev;
+                    index = leaf->items.size();
+                }
+                --index;
+                return *this;
+            }
+
+            Iter operator--(int) noexcept
+            {
+                auto old = *this;
+                --*this;
+                return old;
+            }
+
+            friend bool operator==(const Iter &a, const Iter &b) noexcept
+            {
+                return a.leaf == b.leaf && a.index == b.index;
+            }
+            friend bool operator!=(const Iter &a, const Iter &b) noexcept { return !(a == b); }
+
+        private:
+            friend class ChunkedSequence;
+            friend class Iter<true>;
+
+            Leaf *leaf = nullptr;
+            std::size_t index = 0;
+        };
+
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using reference = T &;
+        using const_reference = const T &;
+        using iterator = Iter<false>;
+        using const_iterator = Iter<true>;
+
+        ChunkedSequence() : root(new Leaf), head(static_cast<Leaf *>(root)), tail(head) {}
+
+        ChunkedSequence(std::initializer_list<T> init) : ChunkedSequence()
+        {
+            for (const auto &x : init)
+                push_back(x);
+        }
+
+        ChunkedSequence(const ChunkedSequence &rhs) : ChunkedSequence()
+        {
+            for (const auto &x : rhs)
+                push_back(x);
+        }
+
+        ChunkedSequence(ChunkedSequence &&rhs) : ChunkedSequence() { swap(rhs); }
+
+        ChunkedSequence &operator=(ChunkedSequence rhs) noexcept
+        {
+            swap(rhs);
+            return *this;
+        }
+
+        ~ChunkedSequence() { destroy(root); }
+
+        void swap(ChunkedSequence &rhs) noexcept
+        {
+            std::swap(root, rhs.root);
+            std::swap(head, rhs.head);
+            std::swap(tail, rhs.tail);
+            std::swap(count, rhs.count);
+        }
+
+        size_type size() const noexcept { return count; }
+        bool empty() const noexcept { return count == 0; }
+
+        // leaves are never empty unless the whole sequence is, so the first
+        // element is always at (head, 0) and end() is one past the last leaf
+        iterator begin() noexcept { return iterator(head, 0); }
+        iterator end() noexcept { return iterator(tail, tail->items.size()); }
+        const_iterator begin() const noexcept { return const_iterator(head, 0); }
+        const_iterator end() const noexcept { return const_iterator(tail, tail->items.size()); }
+        const_iterator cbegin() const noexcept { return begin(); }
+        const_iterator cend() const noexcept { return end(); }
+
+        // O(log n)
+        const_iterator nth(size_type n) const noexcept
+        {
+            if (n >= count)
+                return end();
+
+            const Node *node = root;
+            while (!node->isLeaf)
+            {
+                auto inner = static_cast<const Inner *>(node);
+                std::size_t i = 0;
+                for (; n >= inner->counts[i]; ++i)
+                    n -= inner->counts[i];
+                node = inner->children[i];
+            }
+            return const_iterator(const_cast<Leaf *>(static_cast<const Leaf *>(node)), n);
+        }
+
+        iterator nth(size_type n) noexcept
+        {
+            auto it = static_cast<const ChunkedSequence &>(*this).nth(n);
+            return iterator(it.leaf, it.index);
+        }
+
+        reference operator[](size_type n) noexcept { return *nth(n); }
+        const_reference operator[](size_type n) const noexcept { return *nth(n); }
+
+        // first element not less than value, for a sequence kept sorted by the
+        // caller; O(log n)
+        const_iterator lower_bound(const T &value) const
+        {
+            const Node *node = root;
+            while (!node->isLeaf)
+            {
+                auto inner = static_cast<const Inner *>(node);
+                // the last child whose first element is less than value
+                auto it = std::partition_point(
+                    inner->children.begin() + 1, inner->children.end(),
+                    [&](const Node *child)
+                    { return firstOf(child) < value; });
+                node = *(it - 1);
+            }
+
+            auto leaf = const_cast<Leaf *>(static_cast<const Leaf *>(node));
+            auto pos = std::lower_bound(leaf->items.begin(), leaf->items.end(), value);
+            std::size_t index = pos - leaf->items.begin();
+            if (index == leaf->items.size() && leaf->next)
+                return const_iterator(leaf->next, 0);
+            return const_iterator(leaf, index);
+        }
+
+        iterator insert(const_iterator pos, T value)
+        {
+            Leaf *leaf = pos.leaf;
+            std::size_t index = pos.index;
+
+            leaf->items.insert(leaf->items.begin() + index, std::move(value));
+            ++count;
+            for (Node *child = leaf; Inner *parent = child->parent; child = parent)
+                ++parent->counts[indexIn(parent, child)];
+
+            if (leaf->items.size() > LeafCapacity)
+            {
+                Leaf *right = splitLeaf(leaf);
+                if (index >= leaf->items.size())
+                {
+                    index -= leaf->items.size();
+                    leaf = right;
+                }
+            }
+            return iterator(leaf, index);
+        }
+
+        void push_back(T value) { insert(cend(), std::move(value)); }
+
+        void clear()
+        {
+            ChunkedSequence empty;
+            swap(empty);
+        }
+
+    private:
+        static const T &firstOf(const Node *node) noexcept
+        {
+            while (!node->isLeaf)
+                node = static_cast<const Inner *>(node)->children.front();
+            return static_cast<const Leaf *>(node)->items.front();
+        }
+
+        static std::size_t indexIn(const Inner *parent, const Node *child) noexcept
+        {
+            return std::find(parent->children.begin(), parent->children.end(), child) -
+                   parent->children.begin();
+        }
+
+        Leaf *splitLeaf(Leaf *leaf)
+        {
+            auto right = new Leaf;
+            auto half = leaf->items.begin() + leaf->items.size() / 2;
+            std::move(half, leaf->items.end(), std::back_inserter(right->items));
+            leaf->items.erase(half, leaf->items.end());
+
+            right->prev = leaf;
+            right->next = leaf->next;
+            if (leaf->next)
+                leaf->next->prev = right;
+            else
+                tail = right;
+            leaf->next = right;
+
+            insertChild(leaf, right, right->items.size());
+            return right;
+        }
+
+        void splitInner(Inner *node)
+        {
+            auto right = new Inner;
+            auto half = node->children.size() / 2;
+            right->children.assign(node->children.begin() + half, node->children.end());
+            right->counts.assign(node->counts.begin() + half, node->counts.end());
+            node->children.resize(half);
+            node->counts.resize(half);
+
+            std::size_t rightCount = 0;
+            for (std::size_t i = 0; i != right->children.size(); ++i)
+            {
+                right->children[i]->parent = right;
+                rightCount += right->counts[i];
+            }
+            insertChild(node, right, rightCount);
+        }
+
+        // right (holding rightCount of left's elements) goes in after left
+        void insertChild(Node *left, Node *right, std::size_t rightCount)
+        {
+            Inner *parent = left->parent;
+            if (!parent)
+            {
+                parent = new Inner;
+                parent->children = {left, right};
+                parent->counts = {count - rightCount, rightCount};
+                left->parent = right->parent = parent;
+                root = parent;
+                return;
+            }
+
+            auto j = indexIn(parent, left);
+            parent->counts[j] -= rightCount;
+            parent->children.insert(parent->children.begin() + j + 1, right);
+            parent->counts.insert(parent->counts.begin() + j + 1, rightCount);
+            right->parent = parent;
+
+            if (parent->children.size() > Fanout)
+                splitInner(parent);
+        }
+
+        static void destroy(Node *node) noexcept
+        {
+            if (!node)
+                return;
+            if (node->isLeaf)
+            {
+                delete static_cast<Leaf *>(node);
+                return;
+            }
+            auto inner = static_cast<Inner *>(node);
+            for (Node *child : inner->children)
+                destroy(child);
+            delete inner;
+        }
+
+        Node *root;
+        Leaf *head;
+        Leaf *tail;
+        size_type count = 0;
+    };
+}
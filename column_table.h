@@ -0,0 +1,198 @@
+// Struct-of-arrays table.
+//
+// ColumnTable<Ts...> stores what a std::vector<std::tuple<Ts...>> would, but
+// one column per field: column<I>() is a std::vector of the I-th field, so a
+// scan over one field touches nothing else. Columns are picked by index at
+// compile time, just like std::get, so Item 10's UserInfoFields enums (or
+// toUType on the scoped version) name them too.
+//
+// std::string fields go to a StringColumn instead: every string's characters
+// in one arena, plus an offset per row, rather than a 32-byte std::string
+// (and for longer strings a separate heap block) per row.
+//
+// countWhere/selectWhere scan a numeric column without branching on the
+// data, which lets the optimizer vectorize them.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// a view of a string in a StringColumn; valid until the column grows
+struct StringRef
+{
+    const char *data;
+    std::size_t size;
+
+    std::string str() const { return std::string(data, size); }
+
+    friend bool operator==(StringRef a, StringRef b) noexcept
+    {
+        return a.size == b.size && std::memcmp(a.data, b.data, a.size) == 0;
+    }
+    friend bool operator!=(StringRef a, StringRef b) noexcept { return !(a == b); }
+};
+
+class StringColumn
+{
+public:
+    using value_type = StringRef;
+
+    std::size_t size() const noexcept { return offsets.size() - 1; }
+
+    void reserve(std::size_t rows, std::size_t chars)
+    {
+        offsets.reserve(rows + 1);
+        arena.reserve(chars);
+    }
+
+    void push_back(const char *data, std::size_t size)
+    {
+        arena.insert(arena.end(), data, data + size);
+        offsets.push_back(arena.size());
+    }
+
+    void push_back(const std::string &s) { push_back(s.data(), s.size()); }
+
+    StringRef operator[](std::size_t row) const noexcept
+    {
+        return StringRef{arena.data() + offsets[row], offsets[row + 1] - offsets[row]};
+    }
+
+    // first row equal to s, or size(); only rows of the right length are
+    // compared at all
+    std::size_t find(StringRef s) const noexcept
+    {
+        for (std::size_t row = 0; row != size(); ++row)
+            if (offsets[row + 1] - offsets[row] == s.size &&
+                std::memcmp(arena.data() + offsets[row], s.data, s.size) == 0)
+                return row;
+        return size();
+    }
+
+    std::size_t bytes() const noexcept
+    {
+        return arena.capacity() + offsets.capacity() * sizeof(std::size_t);
+    }
+
+private:
+    std::vector<char> arena;
+    std::vector<std::size_t> offsets{0}; // row i is [offsets[i], offsets[i + 1])
+};
+
+template <typename T>
+struct ColumnFor
+{
+    using type = std::vector<T>;
+};
+
+template <>
+struct ColumnFor<std::string>
+{
+    using type = StringColumn;
+};
+
+template <typename... Ts>
+class ColumnTable
+{
+public:
+    using Row = std::tuple<Ts...>;
+
+    template <std::size_t I>
+    using Column = typename ColumnFor<std::tuple_element_t<I, Row>>::type;
+
+    std::size_t size() const noexcept { return std::get<0>(columns).size(); }
+
+    template <std::size_t I>
+    Column<I> &column() noexcept { return std::get<I>(columns); }
+
+    template <std::size_t I>
+    const Column<I> &column() const noexcept { return std::get<I>(columns); }
+
+    // one field of one row: a reference for ordinary columns, a StringRef
+    // for string columns
+    template <std::size_t I>
+    decltype(auto) get(std::size_t row) const noexcept { return column<I>()[row]; }
+
+    void push_back(const Ts &...values)
+    {
+        pushBack(std::index_sequence_for<Ts...>(), values...);
+    }
+
+    void push_back(const Row &row)
+    {
+        pushRow(row, std::index_sequence_for<Ts...>());
+    }
+
+    Row row(std::size_t i) const
+    {
+        return rowAt(i, std::index_sequence_for<Ts...>());
+    }
+
+private:
+    template <std::size_t... Is>
+    void pushBack(std::index_sequence<Is...>, const Ts &...values)
+    {
+        using expand = int[];
+        (void)expand{0, (std::get<Is>(columns).push_back(values), 0)...};
+    }
+
+    template <std::size_t... Is>
+    void pushRow(const Row &row, std::index_sequence<Is...>)
+    {
+        pushBack(std::index_sequence<Is...>(), std::get<Is>(row)...);
+    }
+
+    template <typename T>
+    static const T &toField(const T &value) { return value; }
+    static std::string toField(StringRef s) { return s.str(); }
+
+    template <std::size_t... Is>
+    Row rowAt(std::size_t i, std::index_sequence<Is...>) const
+    {
+        return Row(toField(std::get<Is>(columns)[i])...);
+    }
+
+    std::tuple<typename ColumnFor<Ts>::type...> columns;
+};
+
+// number of values for which pred holds; pred should be cheap and
+// branch-free (a comparison or two)
+template <typename T, typename Pred>
+std::size_t countWhere(const std::vector<T> &column, Pred pred)
+{
+    std::size_t n = 0;
+    for (const T &x : column)
+        n += pred(x) ? 1 : 0;
+    return n;
+}
+
+// indices of the values for which pred holds, in order. Within a block
+// every index is written and the output position only advances on a match,
+// so there is no data-dependent branch; matches are then appended a block
+// at a time.
+template <typename T, typename Pred>
+std::vector<std::size_t> selectWhere(const std::vector<T> &column, Pred pred)
+{
+    constexpr std::size_t kBlock = 256;
+    std::size_t block[kBlock];
+    std::vector<std::size_t> rows;
+
+    for (std::size_t first = 0; first < column.size(); first += kBlock)
+    {
+        std::size_t last = std::min(first + kBlock, column.size());
+        std::size_t n = 0;
+        for (std::size_t i = first; i != last; ++i)
+        {
+            block[n] = i;
+            n += pred(column[i]) ? 1 : 0;
+        }
+        rows.insert(rows.end(), block, block + n);
+    }
+    return rows;
+}
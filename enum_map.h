@@ -0,0 +1,320 @@
+// Containers indexed by a scoped enum.
+//
+// EnumMap<E, V> is a std::array<V, N> with an entry for every enumerator:
+// operator[] is a single indexed load (the index is Item 10's toUType of the
+// key), and iterating visits all N entries with no hashing and no tests.
+// EnumSet<E> is a bitset over the enumerators.
+//
+// Both need the enumerator count, which REFLECT_ENUM provides along with
+// the enumerator names, all at compile time:
+//
+//     enum class Sound { Beep, Siren, Whistle };
+//     REFLECT_ENUM(Sound, Beep, Siren, Whistle);   // at namespace scope
+//
+// The enumerators must be listed in order and be dense from 0 (no
+// initializers), which is what makes them usable as indices; a list that
+// doesn't match the enum is a compile-time error.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+template <typename E>
+struct EnumTraits; // specialized by REFLECT_ENUM
+
+// Position_::name is name's place in the list, which the static_asserts hold
+// to E::name's value: a list that reorders, misspells or skips enumerators
+// doesn't compile (only leaving off the last ones can't be caught). The
+// positions live in a nested struct, so any enumerator name (count, list,
+// ...) is fine.
+#define REFLECT_ENUM(E, ...)                                                  \
+    template <>                                                               \
+    struct EnumTraits<E>                                                      \
+    {                                                                         \
+        struct Position_                                                      \
+        {                                                                     \
+            enum : std::size_t                                                \
+            {                                                                 \
+                __VA_ARGS__,                                                  \
+                enumCount_                                                    \
+            };                                                                \
+        };                                                                    \
+        static constexpr std::size_t count() noexcept                         \
+        {                                                                     \
+            return Position_::enumCount_;                                     \
+        }                                                                     \
+        static constexpr const char *list() noexcept { return #__VA_ARGS__; } \
+    };                                                                        \
+    REFLECT_ENUM_FOR_EACH(REFLECT_ENUM_CHECK, E, __VA_ARGS__)
+
+#define REFLECT_ENUM_CHECK(E, name)                                     \
+    static_assert(static_cast<std::size_t>(E::name) ==                  \
+                      EnumTraits<E>::Position_::name,                   \
+                  "REFLECT_ENUM: " #E "::" #name " is not at its place " \
+                  "in the list")
+
+// REFLECT_ENUM_FOR_EACH(M, E, a, b, c) is M(E, a); M(E, b); M(E, c), for up to 32 names
+#define REFLECT_ENUM_EXPAND(x) x
+#define REFLECT_ENUM_NTH(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, n, ...) n
+#define REFLECT_ENUM_COUNT(...) \
+    REFLECT_ENUM_EXPAND(REFLECT_ENUM_NTH(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define REFLECT_ENUM_CAT(a, b) REFLECT_ENUM_CAT_(a, b)
+#define REFLECT_ENUM_CAT_(a, b) a##b
+#define REFLECT_ENUM_FOR_EACH(M, E, ...) \
+    REFLECT_ENUM_EXPAND(REFLECT_ENUM_CAT(REFLECT_ENUM_EACH_, REFLECT_ENUM_COUNT(__VA_ARGS__))(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_1(M, E, x) M(E, x)
+#define REFLECT_ENUM_EACH_2(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_1(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_3(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_2(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_4(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_3(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_5(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_4(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_6(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_5(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_7(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_6(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_8(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_7(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_9(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_8(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_10(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_9(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_11(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_10(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_12(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_11(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_13(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_12(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_14(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_13(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_15(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_14(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_16(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_15(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_17(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_16(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_18(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_17(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_19(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_18(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_20(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_19(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_21(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_20(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_22(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_21(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_23(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_22(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_24(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_23(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_25(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_24(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_26(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_25(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_27(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_26(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_28(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_27(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_29(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_28(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_30(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_29(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_31(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_30(M, E, __VA_ARGS__))
+#define REFLECT_ENUM_EACH_32(M, E, x, ...) M(E, x); REFLECT_ENUM_EXPAND(REFLECT_ENUM_EACH_31(M, E, __VA_ARGS__))
+
+struct EnumName
+{
+    const char *data;
+    std::size_t size;
+
+    std::string str() const { return std::string(data, size); }
+
+    friend std::ostream &operator<<(std::ostream &os, EnumName name)
+    {
+        return os.write(name.data, name.size);
+    }
+};
+
+namespace detail
+{
+    constexpr bool isIdentifierChar(char c) noexcept
+    {
+        return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9');
+    }
+
+    // the i-th name in a stringized list like "Beep, Siren, Whistle"
+    constexpr EnumName nthName(const char *list, std::size_t i) noexcept
+    {
+        std::size_t pos = 0;
+        for (;; --i)
+        {
+            while (!isIdentifierChar(list[pos]))
+                ++pos;
+            std::size_t start = pos;
+            while (isIdentifierChar(list[pos]))
+                ++pos;
+            if (i == 0)
+                return EnumName{list + start, pos - start};
+            while (list[pos] != ',')
+                ++pos;
+        }
+    }
+
+    constexpr std::size_t countNames(const char *list) noexcept
+    {
+        std::size_t n = 1;
+        for (; *list; ++list)
+            n += *list == ',';
+        return n;
+    }
+
+    template <typename E, std::size_t... Is>
+    constexpr std::array<EnumName, sizeof...(Is)> makeNames(std::index_sequence<Is...>) noexcept
+    {
+        static_assert(sizeof...(Is) == countNames(EnumTraits<E>::list()),
+                      "REFLECT_ENUM: enumerators must not have initializers");
+        return {{nthName(EnumTraits<E>::list(), Is)...}};
+    }
+
+    template <typename E>
+    constexpr std::size_t enumIndex(E e) noexcept
+    {
+        return static_cast<std::size_t>(static_cast<std::underlying_type_t<E>>(e));
+    }
+}
+
+template <typename E>
+constexpr std::array<EnumName, EnumTraits<E>::count()> kEnumNames =
+    detail::makeNames<E>(std::make_index_sequence<EnumTraits<E>::count()>());
+
+template <typename E>
+constexpr EnumName enumName(E e) noexcept
+{
+    return kEnumNames<E>[detail::enumIndex(e)];
+}
+
+template <typename E, typename V>
+class EnumMap
+{
+public:
+    static constexpr std::size_t N = EnumTraits<E>::count();
+
+    EnumMap() = default;
+
+    EnumMap(std::initializer_list<std::pair<E, V>> init)
+    {
+        for (const auto &kv : init)
+            (*this)[kv.first] = kv.second;
+    }
+
+    static constexpr std::size_t size() noexcept { return N; }
+
+    V &operator[](E key) noexcept { return values[detail::enumIndex(key)]; }
+    const V &operator[](E key) const noexcept { return values[detail::enumIndex(key)]; }
+
+    // the values in enumerator order
+    auto begin() noexcept { return values.begin(); }
+    auto end() noexcept { return values.end(); }
+    auto begin() const noexcept { return values.begin(); }
+    auto end() const noexcept { return values.end(); }
+
+    // f(key, value) for every enumerator
+    template <typename F>
+    void forEach(F &&f)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+            f(static_cast<E>(i), values[i]);
+    }
+
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        for (std::size_t i = 0; i != N; ++i)
+            f(static_cast<E>(i), values[i]);
+    }
+
+private:
+    std::array<V, N> values{};
+};
+
+template <typename E, typename V>
+constexpr std::size_t EnumMap<E, V>::N;
+
+template <typename E>
+class EnumSet
+{
+    using Word = std::uint64_t;
+    static constexpr std::size_t N = EnumTraits<E>::count();
+    static constexpr std::size_t kWords = (N + 63) / 64;
+
+public:
+    EnumSet() = default;
+
+    EnumSet(std::initializer_list<E> init)
+    {
+        for (E e : init)
+            insert(e);
+    }
+
+    static EnumSet all() noexcept
+    {
+        EnumSet s;
+        for (std::size_t i = 0; i != N; ++i)
+            s.words[i / 64] |= Word(1) << (i % 64);
+        return s;
+    }
+
+    void insert(E e) noexcept { words[word(e)] |= bit(e); }
+    void erase(E e) noexcept { words[word(e)] &= ~bit(e); }
+    bool contains(E e) const noexcept { return (words[word(e)] & bit(e)) != 0; }
+
+    std::size_t size() const noexcept
+    {
+        std::size_t n = 0;
+        for (Word w : words)
+            n += popcount(w);
+        return n;
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    // f(e) for every member, in enumerator order
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        for (std::size_t i = 0; i != kWords; ++i)
+            for (Word w = words[i]; w != 0; w &= w - 1)
+                f(static_cast<E>(i * 64 + ctz(w)));
+    }
+
+    friend EnumSet operator|(EnumSet a, const EnumSet &b) noexcept
+    {
+        for (std::size_t i = 0; i != kWords; ++i)
+            a.words[i] |= b.words[i];
+        return a;
+    }
+
+    friend EnumSet operator&(EnumSet a, const EnumSet &b) noexcept
+    {
+        for (std::size_t i = 0; i != kWords; ++i)
+            a.words[i] &= b.words[i];
+        return a;
+    }
+
+    friend bool operator==(const EnumSet &a, const EnumSet &b) noexcept
+    {
+        return a.words == b.words;
+    }
+    friend bool operator!=(const EnumSet &a, const EnumSet &b) noexcept { return !(a == b); }
+
+private:
+    static std::size_t word(E e) noexcept { return detail::enumIndex(e) / 64; }
+    static Word bit(E e) noexcept { return Word(1) << (detail::enumIndex(e) % 64); }
+
+    static unsigned popcount(Word w) noexcept
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(w);
+#else
+        unsigned c = 0;
+        for (; w; w &= w - 1)
+            ++c;
+        return c;
+#endif
+    }
+
+    static unsigned ctz(Word w) noexcept
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(w);
+#else
+        unsigned c = 0;
+        for (; !(w & 1); w >>= 1)
+            ++c;
+        return c;
+#endif
+    }
+
+    std::array<Word, kWords> words{};
+};
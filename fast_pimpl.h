@@ -0,0 +1,85 @@
+// Fast pImpl: the implementation object lives in aligned storage inside the
+// owning class instead of behind a heap pointer.
+//
+// The header only needs the size and alignment to reserve, not the definition
+// of Impl, so the compilation firewall of Item 22 stays in place. The price is
+// that those two numbers are written down in the header; the static_asserts
+// below fire in the implementation file (where Impl is complete) as soon as
+// they are too small.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace detail
+{
+    // true only for a single argument of type Self (or derived from it)
+    template <typename Self, typename... Ts>
+    struct IsSelf : std::false_type
+    {
+    };
+
+    template <typename Self, typename T>
+    struct IsSelf<Self, T> : std::is_base_of<Self, std::decay_t<T>>
+    {
+    };
+}
+
+template <typename T, std::size_t Size, std::size_t Alignment>
+class FastPimpl
+{
+public:
+    // constrained so it doesn't hijack copying and moving (see Item 26/27)
+    template <
+        typename... Ts,
+        typename = std::enable_if_t<!detail::IsSelf<FastPimpl, Ts...>::value>>
+    explicit FastPimpl(Ts &&...params)
+    {
+        new (ptr()) T(std::forward<Ts>(params)...);
+    }
+
+    FastPimpl(const FastPimpl &rhs) { new (ptr()) T(*rhs); }
+    FastPimpl(FastPimpl &&rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        new (ptr()) T(std::move(*rhs));
+    }
+
+    FastPimpl &operator=(const FastPimpl &rhs)
+    {
+        *ptr() = *rhs;
+        return *this;
+    }
+    FastPimpl &operator=(FastPimpl &&rhs) noexcept(std::is_nothrow_move_assignable<T>::value)
+    {
+        *ptr() = std::move(*rhs);
+        return *this;
+    }
+
+    ~FastPimpl() noexcept
+    {
+        validate<sizeof(T), alignof(T)>();
+        ptr()->~T();
+    }
+
+    T *operator->() noexcept { return ptr(); }
+    const T *operator->() const noexcept { return ptr(); }
+    T &operator*() noexcept { return *ptr(); }
+    const T &operator*() const noexcept { return *ptr(); }
+
+private:
+    // the actual numbers appear in the error message when an assertion fails
+    template <std::size_t ActualSize, std::size_t ActualAlignment>
+    static void validate() noexcept
+    {
+        static_assert(Size >= ActualSize, "FastPimpl: Size is too small for T");
+        static_assert(Alignment % ActualAlignment == 0, "FastPimpl: Alignment doesn't suit T");
+    }
+
+    T *ptr() noexcept { return reinterpret_cast<T *>(&storage); }
+    const T *ptr() const noexcept { return reinterpret_cast<const T *>(&storage); }
+
+    typename std::aligned_storage<Size, Alignment>::type storage;
+};
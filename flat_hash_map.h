@@ -0,0 +1,770 @@
+// Open-addressing hash map and set (SwissTable layout).
+//
+// FlatHashMap<K, V> and FlatHashSet<K> keep their elements in one array of
+// slots, with no node per element, and a parallel array of one control byte
+// per slot: empty, deleted, or the low 7 bits of the hash of the element in
+// it. A lookup hashes once, picks a start from the remaining bits, and
+// compares 16 control bytes at a time with the 7 stored bits (one SSE2
+// compare where available); only slots whose byte matches are compared for
+// real, so a miss rarely touches an element at all. Probing goes from
+// group to group in triangular steps and stops at the first group with an
+// empty slot. The table grows at 7/8 full.
+//
+// With a transparent Hash and Eq (both declaring is_transparent), find,
+// count, contains, erase, try_emplace and operator[] take anything the two
+// accept, and build a key only to insert it. FlatHash and FlatEqual, the
+// defaults, are transparent for std::string: a std::string key can be looked
+// up with a const char * or anything with data() and size() (such as a
+// string_view) without constructing a std::string.
+//
+// Iteration runs in slot order. Erasing leaves every other element where it
+// is, so erasing never invalidates other iterators, and iteration can go on
+// past an erased element; inserting may rehash and move everything. Elements
+// are moved when the table rehashes, key included.
+//
+// Built as C++17, a table takes its memory from a std::pmr::memory_resource,
+// the default one unless given another, and elements are built with
+// uses-allocator construction, so a std::pmr::string key draws from the same
+// resource. A table keeps its resource through moves and swaps; a copy gets
+// the default one, as a std::pmr container's does, and assigning a table
+// hands over the storage, resource included.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define FLAT_HASH_SSE2 1
+#endif
+
+#if __cplusplus >= 201703L && __has_include(<memory_resource>)
+#include <memory_resource>
+#define FLAT_HASH_PMR 1
+#endif
+
+namespace detail
+{
+    struct StringBytes
+    {
+        const char *data;
+        std::size_t size;
+    };
+
+    inline StringBytes stringBytes(const char *s) noexcept { return StringBytes{s, std::strlen(s)}; }
+
+    template <typename S, typename = decltype(std::declval<const S &>().data(), std::declval<const S &>().size())>
+    StringBytes stringBytes(const S &s) noexcept
+    {
+        return StringBytes{s.data(), s.size()};
+    }
+}
+
+// hashes and compares std::string, const char * and string views alike
+struct StringHash
+{
+    using is_transparent = void;
+
+    template <typename S>
+    std::size_t operator()(const S &s) const noexcept
+    {
+        detail::StringBytes b = detail::stringBytes(s);
+        const char *p = b.data;
+        std::size_t n = b.size;
+        std::uint64_t h = 0x9E3779B97F4A7C15ULL ^ n;
+        for (; n >= 8; p += 8, n -= 8)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, p, 8);
+            h = (h ^ w) * 0xbf58476d1ce4e5b9ULL;
+            h ^= h >> 31;
+        }
+        std::uint64_t w = 0;
+        std::memcpy(&w, p, n);
+        h = (h ^ w) * 0x94d049bb133111ebULL;
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
+};
+
+struct StringEqual
+{
+    using is_transparent = void;
+
+    template <typename A, typename B>
+    bool operator()(const A &a, const B &b) const noexcept
+    {
+        detail::StringBytes x = detail::stringBytes(a), y = detail::stringBytes(b);
+        return x.size == y.size && std::memcmp(x.data, y.data, x.size) == 0;
+    }
+};
+
+template <typename K>
+struct FlatHash : std::hash<K>
+{
+};
+
+template <>
+struct FlatHash<std::string> : StringHash
+{
+};
+
+#if defined(FLAT_HASH_PMR)
+template <>
+struct FlatHash<std::pmr::string> : StringHash
+{
+};
+#endif
+
+template <typename K>
+struct FlatEqual : std::equal_to<K>
+{
+};
+
+template <>
+struct FlatEqual<std::string> : StringEqual
+{
+};
+
+#if defined(FLAT_HASH_PMR)
+template <>
+struct FlatEqual<std::pmr::string> : StringEqual
+{
+};
+#endif
+
+namespace detail
+{
+    constexpr std::int8_t kCtrlEmpty = -128;
+    constexpr std::int8_t kCtrlDeleted = -2;
+    constexpr std::size_t kGroupWidth = 16;
+
+    inline unsigned lowestBit(std::uint32_t m) noexcept
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(m);
+#else
+        unsigned c = 0;
+        for (; !(m & 1); m >>= 1)
+            ++c;
+        return c;
+#endif
+    }
+
+    // zero bits above the highest set bit of a 16-bit mask
+    inline unsigned leadingZeros16(std::uint32_t m) noexcept
+    {
+        unsigned c = 0;
+        for (std::uint32_t bit = 0x8000; bit && !(m & bit); bit >>= 1)
+            ++c;
+        return c;
+    }
+
+    // 16 control bytes; each match is a mask with bit i set for byte i
+    class CtrlGroup
+    {
+    public:
+        explicit CtrlGroup(const std::int8_t *p) noexcept
+        {
+#if defined(FLAT_HASH_SSE2)
+            ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+#else
+            std::memcpy(ctrl, p, kGroupWidth);
+#endif
+        }
+
+        std::uint32_t match(std::int8_t h2) const noexcept
+        {
+#if defined(FLAT_HASH_SSE2)
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))));
+#else
+            std::uint32_t m = 0;
+            for (std::size_t i = 0; i != kGroupWidth; ++i)
+                m |= std::uint32_t(ctrl[i] == h2) << i;
+            return m;
+#endif
+        }
+
+        std::uint32_t matchEmpty() const noexcept { return match(kCtrlEmpty); }
+
+        // empty or deleted: the only negative bytes
+        std::uint32_t matchFree() const noexcept
+        {
+#if defined(FLAT_HASH_SSE2)
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+            std::uint32_t m = 0;
+            for (std::size_t i = 0; i != kGroupWidth; ++i)
+                m |= std::uint32_t(ctrl[i] < 0) << i;
+            return m;
+#endif
+        }
+
+    private:
+#if defined(FLAT_HASH_SSE2)
+        __m128i ctrl;
+#else
+        std::int8_t ctrl[kGroupWidth];
+#endif
+    };
+
+    template <typename Hash, typename Eq>
+    struct IsTransparent
+    {
+        template <typename T>
+        static std::true_type test(typename T::is_transparent *);
+        template <typename T>
+        static std::false_type test(...);
+
+        static constexpr bool value = decltype(test<Hash>(nullptr))::value && decltype(test<Eq>(nullptr))::value;
+    };
+
+    template <typename K, typename V>
+    struct FlatMapPolicy
+    {
+        using key_type = K;
+        using value_type = std::pair<const K, V>;
+        static constexpr bool kConstValues = false;
+
+        static const K &key(const value_type &v) noexcept { return v.first; }
+
+        // moves *src into dst and destroys it; the key is moved from as
+        // well, since this is the last anyone sees of it
+        static void transfer(value_type *dst, value_type *src)
+        {
+            new (dst) value_type(std::move(const_cast<K &>(src->first)), std::move(src->second));
+            src->~value_type();
+        }
+    };
+
+    template <typename K>
+    struct FlatSetPolicy
+    {
+        using key_type = K;
+        using value_type = K;
+        static constexpr bool kConstValues = true;
+
+        static const K &key(const value_type &v) noexcept { return v; }
+
+        static void transfer(value_type *dst, value_type *src)
+        {
+            new (dst) value_type(std::move(*src));
+            src->~value_type();
+        }
+    };
+
+    template <typename Policy, typename Hash, typename Eq>
+    class FlatTable
+    {
+    public:
+        using key_type = typename Policy::key_type;
+        using value_type = typename Policy::value_type;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Eq;
+
+        template <bool Const>
+        class Iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = typename Policy::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+            using reference = std::conditional_t<Const, const value_type &, value_type &>;
+
+            Iterator() noexcept = default;
+
+            template <bool C, typename = std::enable_if_t<Const && !C>>
+            Iterator(const Iterator<C> &rhs) noexcept : ctrl(rhs.ctrl), last(rhs.last), slot(rhs.slot)
+            {
+            }
+
+            reference operator*() const noexcept { return *slot; }
+            pointer operator->() const noexcept { return slot; }
+
+            Iterator &operator++() noexcept
+            {
+                ++ctrl;
+                ++slot;
+                skipFree();
+                return *this;
+            }
+
+            Iterator operator++(int) noexcept
+            {
+                Iterator old = *this;
+                ++*this;
+                return old;
+            }
+
+            friend bool operator==(const Iterator &a, const Iterator &b) noexcept { return a.slot == b.slot; }
+            friend bool operator!=(const Iterator &a, const Iterator &b) noexcept { return a.slot != b.slot; }
+
+        private:
+            friend class FlatTable;
+            template <bool>
+            friend class Iterator;
+
+            Iterator(const std::int8_t *ctrl, const std::int8_t *last, value_type *slot) noexcept
+                : ctrl(ctrl), last(last), slot(slot)
+            {
+                skipFree();
+            }
+
+            void skipFree() noexcept
+            {
+                for (; ctrl != last && *ctrl < 0; ++ctrl)
+                    ++slot;
+            }
+
+            const std::int8_t *ctrl = nullptr;
+            const std::int8_t *last = nullptr;
+            value_type *slot = nullptr;
+        };
+
+        using iterator = Iterator<Policy::kConstValues>;
+        using const_iterator = Iterator<true>;
+
+        FlatTable() noexcept = default;
+
+        // room for n elements without rehashing
+        explicit FlatTable(std::size_t n, const Hash &hash = Hash(), const Eq &eq = Eq())
+            : hash(hash), eq(eq)
+        {
+            reserve(n);
+        }
+
+#if defined(FLAT_HASH_PMR)
+        explicit FlatTable(std::pmr::memory_resource *resource) noexcept : resource(resource) {}
+
+        FlatTable(std::size_t n, std::pmr::memory_resource *resource) : resource(resource)
+        {
+            reserve(n);
+        }
+#endif
+
+        FlatTable(const FlatTable &rhs) : hash(rhs.hash), eq(rhs.eq)
+        {
+            reserve(rhs.used);
+            for (const value_type &v : rhs)
+            {
+                std::uint64_t h = hashOf(Policy::key(v));
+                std::size_t i = findFree(h);
+                construct(slots + i, v);
+                setCtrl(i, h2Of(h));
+                ++used;
+                --growthLeft;
+            }
+        }
+
+        FlatTable(FlatTable &&rhs) noexcept
+            : hash(std::move(rhs.hash)), eq(std::move(rhs.eq)), ctrl(rhs.ctrl), slots(rhs.slots),
+              cap(rhs.cap), used(rhs.used), growthLeft(rhs.growthLeft)
+#if defined(FLAT_HASH_PMR)
+              , resource(rhs.resource)
+#endif
+        {
+            rhs.forget();
+        }
+
+        FlatTable &operator=(FlatTable rhs) noexcept
+        {
+            swap(rhs);
+            return *this;
+        }
+
+        ~FlatTable()
+        {
+            destroyAll();
+            release();
+        }
+
+        void swap(FlatTable &rhs) noexcept
+        {
+            using std::swap;
+            swap(hash, rhs.hash);
+            swap(eq, rhs.eq);
+            swap(ctrl, rhs.ctrl);
+            swap(slots, rhs.slots);
+            swap(cap, rhs.cap);
+            swap(used, rhs.used);
+            swap(growthLeft, rhs.growthLeft);
+#if defined(FLAT_HASH_PMR)
+            swap(resource, rhs.resource);
+#endif
+        }
+
+#if defined(FLAT_HASH_PMR)
+        std::pmr::memory_resource *memoryResource() const noexcept { return resource; }
+#endif
+
+        iterator begin() noexcept { return iterator(ctrl, ctrl + cap, slots); }
+        iterator end() noexcept { return iterator(ctrl + cap, ctrl + cap, slots + cap); }
+        const_iterator begin() const noexcept { return const_iterator(ctrl, ctrl + cap, slots); }
+        const_iterator end() const noexcept { return const_iterator(ctrl + cap, ctrl + cap, slots + cap); }
+
+        std::size_t size() const noexcept { return used; }
+        bool empty() const noexcept { return used == 0; }
+        std::size_t bucket_count() const noexcept { return cap; }
+        float load_factor() const noexcept { return cap ? float(used) / cap : 0; }
+
+        void reserve(std::size_t n)
+        {
+            std::size_t c = kMinCapacity;
+            while (growthOf(c) < n)
+                c *= 2;
+            if (c > cap)
+                resize(c);
+        }
+
+        // at least `buckets` slots, and enough for the elements
+        void rehash(std::size_t buckets)
+        {
+            std::size_t c = kMinCapacity;
+            while (c < buckets || growthOf(c) < used)
+                c *= 2;
+            resize(c);
+        }
+
+        void clear() noexcept
+        {
+            destroyAll();
+            if (cap)
+            {
+                std::memset(ctrl, kCtrlEmpty, cap + kGroupWidth);
+                growthLeft = growthOf(cap);
+            }
+            used = 0;
+        }
+
+        template <typename L>
+        iterator find(const L &key)
+        {
+            std::size_t i = findIndex<LookupKey<L>>(key);
+            return i == cap ? end() : iterator(ctrl + i, ctrl + cap, slots + i);
+        }
+
+        template <typename L>
+        const_iterator find(const L &key) const
+        {
+            std::size_t i = findIndex<LookupKey<L>>(key);
+            return i == cap ? end() : const_iterator(ctrl + i, ctrl + cap, slots + i);
+        }
+
+        template <typename L>
+        bool contains(const L &key) const { return findIndex<LookupKey<L>>(key) != cap; }
+
+        template <typename L>
+        std::size_t count(const L &key) const { return contains(key); }
+
+        template <typename L>
+        std::size_t erase(const L &key)
+        {
+            std::size_t i = findIndex<LookupKey<L>>(key);
+            if (i == cap)
+                return 0;
+            eraseAt(i);
+            return 1;
+        }
+
+        // the element after it is still it + 1
+        template <bool Const>
+        void erase(Iterator<Const> it) { eraseAt(static_cast<std::size_t>(it.slot - slots)); }
+
+    protected:
+        template <typename L>
+        using LookupKey = std::conditional_t<IsTransparent<Hash, Eq>::value, L, key_type>;
+
+        // finds key, or makes a place for it with make(void *slot, key),
+        // which gets key as passed, or already converted to key_type if the
+        // table isn't transparent
+        template <typename L, typename Make>
+        std::pair<iterator, bool> findOrMake(L &&key, Make make)
+        {
+            return findOrMakeImpl(std::forward<L>(key), make,
+                                  std::integral_constant<bool, IsTransparent<Hash, Eq>::value>());
+        }
+
+        // builds an element in a free slot, passing the table's resource on
+        // to anything in it that takes one
+        template <typename... Args>
+        void construct(value_type *slot, Args &&...args)
+        {
+#if defined(FLAT_HASH_PMR)
+            std::pmr::polymorphic_allocator<value_type>(resource).construct(slot, std::forward<Args>(args)...);
+#else
+            new (slot) value_type(std::forward<Args>(args)...);
+#endif
+        }
+
+    private:
+        static constexpr std::size_t kMinCapacity = kGroupWidth;
+
+        static std::size_t growthOf(std::size_t c) noexcept { return c - c / 8; }
+
+        // std::hash of an integer is the integer itself: mix it, as the
+        // low 7 bits go to the control byte and the rest choose the group
+        template <typename L>
+        std::uint64_t hashOf(const L &key) const
+        {
+            std::uint64_t h = static_cast<std::uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ULL;
+            return h ^ (h >> 32);
+        }
+
+        static std::int8_t h2Of(std::uint64_t h) noexcept { return static_cast<std::int8_t>(h & 0x7F); }
+
+        template <typename L>
+        std::size_t findIndex(const L &key) const
+        {
+            return cap ? findIndex(key, hashOf(key)) : 0;
+        }
+
+        // cap if absent
+        template <typename L>
+        std::size_t findIndex(const L &key, std::uint64_t h) const
+        {
+            const std::size_t mask = cap - 1;
+            const std::int8_t h2 = h2Of(h);
+            std::size_t pos = (h >> 7) & mask;
+            for (std::size_t step = kGroupWidth;; step += kGroupWidth)
+            {
+                CtrlGroup group(ctrl + pos);
+                for (std::uint32_t m = group.match(h2); m; m &= m - 1)
+                {
+                    std::size_t i = (pos + lowestBit(m)) & mask;
+                    if (eq(Policy::key(slots[i]), key))
+                        return i;
+                }
+                if (group.matchEmpty()) // key would have gone there
+                    return cap;
+                pos = (pos + step) & mask;
+            }
+        }
+
+        // the first empty or deleted slot on h's probe sequence
+        std::size_t findFree(std::uint64_t h) const noexcept
+        {
+            const std::size_t mask = cap - 1;
+            std::size_t pos = (h >> 7) & mask;
+            for (std::size_t step = kGroupWidth;; step += kGroupWidth)
+            {
+                if (std::uint32_t m = CtrlGroup(ctrl + pos).matchFree())
+                    return (pos + lowestBit(m)) & mask;
+                pos = (pos + step) & mask;
+            }
+        }
+
+        template <typename L, typename Make>
+        std::pair<iterator, bool> findOrMakeImpl(L &&key, Make &make, std::true_type)
+        {
+            std::uint64_t h = hashOf(key);
+            if (cap)
+            {
+                std::size_t i = findIndex(key, h);
+                if (i != cap)
+                    return std::make_pair(iterator(ctrl + i, ctrl + cap, slots + i), false);
+            }
+            return std::make_pair(insertAt(h, [&](void *slot)
+                                           { make(slot, std::forward<L>(key)); }),
+                                  true);
+        }
+
+        template <typename L, typename Make>
+        std::pair<iterator, bool> findOrMakeImpl(L &&key, Make &make, std::false_type)
+        {
+            return findOrMakeImpl(key_type(std::forward<L>(key)), make, std::true_type());
+        }
+
+        // constructs an element for hash h in a free slot
+        template <typename Construct>
+        iterator insertAt(std::uint64_t h, Construct construct)
+        {
+            std::size_t i = cap ? findFree(h) : 0;
+            if (cap == 0 || (growthLeft == 0 && ctrl[i] == kCtrlEmpty))
+            {
+                // full of tombstones: clean them out; otherwise grow
+                resize(cap == 0 ? kMinCapacity : used <= growthOf(cap) / 2 ? cap : cap * 2);
+                i = findFree(h);
+            }
+            construct(slots + i); // nothing has changed if this throws
+            if (ctrl[i] == kCtrlEmpty)
+                --growthLeft;
+            setCtrl(i, h2Of(h));
+            ++used;
+            return iterator(ctrl + i, ctrl + cap, slots + i);
+        }
+
+        void setCtrl(std::size_t i, std::int8_t c) noexcept
+        {
+            ctrl[i] = c;
+            if (i < kGroupWidth) // mirrored after the end, for groups that wrap
+                ctrl[cap + i] = c;
+        }
+
+        void eraseAt(std::size_t i)
+        {
+            slots[i].~value_type();
+            --used;
+            // if no probe can have gone past this slot, it may be empty
+            // again; otherwise it's a tombstone probes must keep going over
+            const std::size_t mask = cap - 1;
+            std::uint32_t emptyAfter = CtrlGroup(ctrl + i).matchEmpty();
+            std::uint32_t emptyBefore = CtrlGroup(ctrl + ((i - kGroupWidth) & mask)).matchEmpty();
+            if (emptyAfter && emptyBefore && lowestBit(emptyAfter) + leadingZeros16(emptyBefore) < kGroupWidth)
+            {
+                setCtrl(i, kCtrlEmpty);
+                ++growthLeft;
+            }
+            else
+                setCtrl(i, kCtrlDeleted);
+        }
+
+        void *allocate(std::size_t bytes, std::size_t alignment)
+        {
+#if defined(FLAT_HASH_PMR)
+            return resource->allocate(bytes, alignment);
+#else
+            (void)alignment;
+            return ::operator new(bytes);
+#endif
+        }
+
+        void deallocate(void *p, std::size_t bytes, std::size_t alignment) noexcept
+        {
+#if defined(FLAT_HASH_PMR)
+            resource->deallocate(p, bytes, alignment);
+#else
+            (void)bytes;
+            (void)alignment;
+            ::operator delete(p);
+#endif
+        }
+
+        void resize(std::size_t newCap)
+        {
+            auto *newCtrl = static_cast<std::int8_t *>(allocate(newCap + kGroupWidth, 1));
+            value_type *newSlots;
+            try
+            {
+                newSlots = static_cast<value_type *>(allocate(newCap * sizeof(value_type), alignof(value_type)));
+            }
+            catch (...)
+            {
+                deallocate(newCtrl, newCap + kGroupWidth, 1);
+                throw;
+            }
+            std::memset(newCtrl, kCtrlEmpty, newCap + kGroupWidth);
+
+            std::int8_t *oldCtrl = ctrl;
+            value_type *oldSlots = slots;
+            std::size_t oldCap = cap;
+            ctrl = newCtrl;
+            slots = newSlots;
+            cap = newCap;
+            growthLeft = growthOf(newCap) - used;
+            for (std::size_t i = 0; i != oldCap; ++i)
+            {
+                if (oldCtrl[i] < 0)
+                    continue;
+                std::uint64_t h = hashOf(Policy::key(oldSlots[i]));
+                std::size_t j = findFree(h);
+                Policy::transfer(slots + j, oldSlots + i);
+                setCtrl(j, h2Of(h));
+            }
+            if (oldCap)
+            {
+                deallocate(oldCtrl, oldCap + kGroupWidth, 1);
+                deallocate(oldSlots, oldCap * sizeof(value_type), alignof(value_type));
+            }
+        }
+
+        void destroyAll() noexcept
+        {
+            for (std::size_t i = 0; i != cap; ++i)
+                if (ctrl[i] >= 0)
+                    slots[i].~value_type();
+        }
+
+        void release() noexcept
+        {
+            if (cap)
+            {
+                deallocate(ctrl, cap + kGroupWidth, 1);
+                deallocate(slots, cap * sizeof(value_type), alignof(value_type));
+            }
+        }
+
+        void forget() noexcept
+        {
+            ctrl = nullptr;
+            slots = nullptr;
+            cap = used = growthLeft = 0;
+        }
+
+        Hash hash;
+        Eq eq;
+        std::int8_t *ctrl = nullptr; // cap bytes, then the first 16 again
+        value_type *slots = nullptr;
+        std::size_t cap = 0;        // 0, or a power of two from 16
+        std::size_t used = 0; // elements
+        std::size_t growthLeft = 0; // insertions into empty slots before a rehash
+#if defined(FLAT_HASH_PMR)
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource();
+#endif
+    };
+}
+
+template <typename K, typename V, typename Hash = FlatHash<K>, typename Eq = FlatEqual<K>>
+class FlatHashMap : public detail::FlatTable<detail::FlatMapPolicy<K, V>, Hash, Eq>
+{
+    using Base = detail::FlatTable<detail::FlatMapPolicy<K, V>, Hash, Eq>;
+
+public:
+    using mapped_type = V;
+    using typename Base::iterator;
+    using typename Base::value_type;
+
+    using Base::Base;
+
+    // V(args...) is built only if key isn't there yet
+    template <typename L, typename... Args>
+    std::pair<iterator, bool> try_emplace(L &&key, Args &&...args)
+    {
+        return Base::findOrMake(std::forward<L>(key), [&](void *slot, auto &&k)
+                                { this->construct(static_cast<value_type *>(slot), std::piecewise_construct,
+                                                  std::forward_as_tuple(std::forward<decltype(k)>(k)),
+                                                  std::forward_as_tuple(std::forward<Args>(args)...)); });
+    }
+
+    std::pair<iterator, bool> insert(const value_type &v) { return try_emplace(v.first, v.second); }
+
+    template <typename L>
+    V &operator[](L &&key) { return try_emplace(std::forward<L>(key)).first->second; }
+};
+
+template <typename K, typename Hash = FlatHash<K>, typename Eq = FlatEqual<K>>
+class FlatHashSet : public detail::FlatTable<detail::FlatSetPolicy<K>, Hash, Eq>
+{
+    using Base = detail::FlatTable<detail::FlatSetPolicy<K>, Hash, Eq>;
+
+public:
+    using typename Base::iterator;
+
+    using Base::Base;
+
+    // builds a K from key only if it isn't there yet
+    template <typename L>
+    std::pair<iterator, bool> insert(L &&key)
+    {
+        return Base::findOrMake(std::forward<L>(key), [this](void *slot, auto &&k)
+                                { this->construct(static_cast<K *>(slot), std::forward<decltype(k)>(k)); });
+    }
+};
@@ -0,0 +1,125 @@
+// std::function without the heap.
+//
+// InplaceFunction<R(Args...), Capacity> stores the callable in an internal
+// buffer of Capacity bytes; a callable that doesn't fit is a compile-time
+// error instead of a hidden allocation. It's move-only, so closures may
+// capture move-only objects (Item 32).
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, std::size_t Capacity = 48>
+class InplaceFunction;
+
+template <typename R, typename... Args, std::size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+public:
+    InplaceFunction() noexcept = default;
+    InplaceFunction(std::nullptr_t) noexcept {}
+
+    template <
+        typename F,
+        typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InplaceFunction>::value>>
+    InplaceFunction(F &&f)
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Capacity, "callable too large for InplaceFunction");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable over-aligned");
+        static_assert(std::is_nothrow_move_constructible<Fn>::value,
+                      "InplaceFunction needs a noexcept move constructor");
+
+        new (&storage) Fn(std::forward<F>(f));
+        ops = opsFor<Fn>();
+    }
+
+    InplaceFunction(InplaceFunction &&rhs) noexcept { takeFrom(rhs); }
+
+    InplaceFunction &operator=(InplaceFunction &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            takeFrom(rhs);
+        }
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction &) = delete;
+    InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+    ~InplaceFunction() { reset(); }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    R operator()(Args... args)
+    {
+        return ops->invoke(&storage, std::forward<Args>(args)...);
+    }
+
+    void reset() noexcept
+    {
+        if (ops)
+        {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops
+    {
+        R (*invoke)(void *, Args &&...);
+        void (*relocate)(void *dst, void *src) noexcept; // move, then destroy src
+        void (*destroy)(void *) noexcept;
+    };
+
+    template <typename Fn>
+    static R invokeImpl(void *p, Args &&...args)
+    {
+        return (*static_cast<Fn *>(p))(std::forward<Args>(args)...);
+    }
+
+    template <typename Fn>
+    static void relocateImpl(void *dst, void *src) noexcept
+    {
+        new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+        static_cast<Fn *>(src)->~Fn();
+    }
+
+    template <typename Fn>
+    static void destroyImpl(void *p) noexcept
+    {
+        static_cast<Fn *>(p)->~Fn();
+    }
+
+    template <typename Fn>
+    static const Ops *opsFor() noexcept
+    {
+        static const Ops table{&invokeImpl<Fn>, &relocateImpl<Fn>, &destroyImpl<Fn>};
+        return &table;
+    }
+
+    void takeFrom(InplaceFunction &rhs) noexcept
+    {
+        if (rhs.ops)
+        {
+            rhs.ops->relocate(&storage, &rhs.storage);
+            ops = rhs.ops;
+            rhs.ops = nullptr;
+        }
+    }
+
+    typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type storage;
+    const Ops *ops = nullptr;
+};
+
+// what a task submitted as f returns: the pools call a decayed copy of f as an
+// lvalue, with no arguments (std::result_of does the same, but is deprecated
+// in C++17 and gone in C++20)
+template <typename F>
+using TaskResult = decltype(std::declval<std::decay_t<F> &>()());
@@ -0,0 +1,316 @@
+// Counting copies, moves and allocations.
+//
+// Instrumented<T> derives from T and adds no data, so it has T's size and
+// layout (an empty T stays empty, and still benefits from the empty base
+// optimization wherever it is used). Its special member functions forward
+// to T's and count what happened: constructions, copies, moves, copy and
+// move assignments, destructions. Copying from a const rvalue, as in
+// Item 23's D d6(std::move(d2)), is counted as the copy it is.
+//
+// INSTRUMENT_SITE("name") marks the enclosing scope as a call site: every
+// counted operation on the calling thread until the scope ends is also
+// charged to the site. With INSTRUMENT_ALLOCATIONS defined before the
+// include, this header replaces the global operator new and delete as well,
+// and charges each heap allocation made inside a site to that site. (Define
+// it in one translation unit only; every item here is a single one.)
+//
+// At exit, a summary of every instrumented type and every site that was
+// entered goes to stderr. Counters are atomic, so any thread may use them.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+struct InstrumentCounts
+{
+    std::atomic<std::uint64_t> constructed{0};
+    std::atomic<std::uint64_t> copied{0};
+    std::atomic<std::uint64_t> moved{0};
+    std::atomic<std::uint64_t> copyAssigned{0};
+    std::atomic<std::uint64_t> moveAssigned{0};
+    std::atomic<std::uint64_t> destroyed{0};
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> allocatedBytes{0};
+};
+
+struct InstrumentSite
+{
+    InstrumentSite(const char *name, const char *file, int line);
+
+    const char *name;
+    const char *file;
+    int line;
+    InstrumentCounts counts;
+    std::atomic<bool> entered{false};
+    InstrumentSite *next = nullptr;
+};
+
+namespace detail
+{
+    struct InstrumentedType
+    {
+        explicit InstrumentedType(const std::type_info &type);
+
+        const std::type_info &type;
+        InstrumentCounts counts;
+        InstrumentedType *next = nullptr;
+    };
+
+    // both lists only ever grow, and nodes are never freed
+    struct InstrumentRegistry
+    {
+        InstrumentRegistry() { std::atexit(printSummary); }
+
+        template <typename Node>
+        static void push(std::atomic<Node *> &head, Node *node) noexcept
+        {
+            node->next = head.load(std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                               std::memory_order_relaxed))
+            {
+            }
+        }
+
+        static std::string typeName(const std::type_info &type)
+        {
+#if defined(__GNUC__)
+            int status = 0;
+            char *name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+            if (status == 0)
+            {
+                std::string s(name);
+                std::free(name);
+                return s;
+            }
+#endif
+            return type.name();
+        }
+
+        static void printSummary();
+
+        std::atomic<InstrumentedType *> types{nullptr};
+        std::atomic<InstrumentSite *> sites{nullptr};
+    };
+
+    inline InstrumentRegistry &instrumentRegistry()
+    {
+        static InstrumentRegistry registry;
+        return registry;
+    }
+
+    inline void InstrumentRegistry::printSummary()
+    {
+        auto load = [](const std::atomic<std::uint64_t> &n)
+        {
+            return static_cast<unsigned long long>(n.load(std::memory_order_relaxed));
+        };
+        InstrumentRegistry &r = instrumentRegistry();
+
+        std::vector<InstrumentedType *> types;
+        for (auto *t = r.types.load(std::memory_order_acquire); t; t = t->next)
+            types.push_back(t);
+        std::reverse(types.begin(), types.end()); // in order of first use
+
+        std::fprintf(stderr, "\n%-44s %12s %12s %12s %12s %12s %12s\n", "instrumented type",
+                     "constructed", "copied", "moved", "copy=", "move=", "destroyed");
+        for (auto *t : types)
+        {
+            const InstrumentCounts &c = t->counts;
+            std::fprintf(stderr, "%-44s %12llu %12llu %12llu %12llu %12llu %12llu\n",
+                         typeName(t->type).c_str(), load(c.constructed), load(c.copied),
+                         load(c.moved), load(c.copyAssigned), load(c.moveAssigned),
+                         load(c.destroyed));
+        }
+
+        std::vector<InstrumentSite *> sites;
+        for (auto *s = r.sites.load(std::memory_order_acquire); s; s = s->next)
+            sites.push_back(s);
+        std::reverse(sites.begin(), sites.end());
+        if (sites.empty())
+            return;
+
+        // copy= and move= are folded into copied and moved here
+        std::fprintf(stderr, "\n%-44s %12s %12s %12s %12s %12s\n", "site", "constructed",
+                     "copied", "moved", "allocations", "bytes");
+        for (auto *s : sites)
+        {
+            const InstrumentCounts &c = s->counts;
+            std::fprintf(stderr, "%-44s %12llu %12llu %12llu %12llu %12llu\n    at %s:%d\n",
+                         s->name, load(c.constructed), load(c.copied) + load(c.copyAssigned),
+                         load(c.moved) + load(c.moveAssigned), load(c.allocations),
+                         load(c.allocatedBytes), s->file, s->line);
+        }
+    }
+
+    inline InstrumentedType::InstrumentedType(const std::type_info &type) : type(type)
+    {
+        InstrumentRegistry::push(instrumentRegistry().types, this);
+    }
+
+    // the innermost site the calling thread is in, if any; trivially
+    // constructible, so operator new can read it at any time
+    inline InstrumentSite *&currentSite() noexcept
+    {
+        static thread_local InstrumentSite *site = nullptr;
+        return site;
+    }
+
+    template <typename T>
+    InstrumentedType &instrumentedType()
+    {
+        static InstrumentedType type(typeid(T));
+        return type;
+    }
+
+    inline void count(InstrumentCounts &counts, std::atomic<std::uint64_t> InstrumentCounts::*which,
+                      std::uint64_t n = 1) noexcept
+    {
+        (counts.*which).fetch_add(n, std::memory_order_relaxed);
+        if (InstrumentSite *site = currentSite())
+            (site->counts.*which).fetch_add(n, std::memory_order_relaxed);
+    }
+
+    template <typename Self, typename... Ts>
+    struct IsInstrumentedSelf : std::false_type
+    {
+    };
+
+    template <typename Self, typename T>
+    struct IsInstrumentedSelf<Self, T> : std::is_same<std::decay_t<T>, Self>
+    {
+    };
+}
+
+inline InstrumentSite::InstrumentSite(const char *name, const char *file, int line)
+    : name(name), file(file), line(line)
+{
+}
+
+// makes site the calling thread's current site until destroyed
+class InstrumentScope
+{
+public:
+    explicit InstrumentScope(InstrumentSite &site) noexcept : previous(detail::currentSite())
+    {
+        // registered on first entry, so only sites that ran are reported
+        if (!site.entered.exchange(true, std::memory_order_relaxed))
+            detail::InstrumentRegistry::push(detail::instrumentRegistry().sites, &site);
+        detail::currentSite() = &site;
+    }
+
+    InstrumentScope(const InstrumentScope &) = delete;
+    InstrumentScope &operator=(const InstrumentScope &) = delete;
+
+    ~InstrumentScope() { detail::currentSite() = previous; }
+
+private:
+    InstrumentSite *previous;
+};
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_SITE(name)                                                           \
+    static InstrumentSite INSTRUMENT_CONCAT(instrumentSite_, __LINE__)(name, __FILE__, \
+                                                                       __LINE__);      \
+    InstrumentScope INSTRUMENT_CONCAT(instrumentScope_, __LINE__)(                     \
+        INSTRUMENT_CONCAT(instrumentSite_, __LINE__))
+
+template <typename T>
+class Instrumented : public T
+{
+    static_assert(std::is_class<T>::value && !std::is_final<T>::value,
+                  "Instrumented<T> derives from T");
+
+public:
+    Instrumented() : T() { count(&InstrumentCounts::constructed); }
+
+    template <typename... Ts,
+              typename = std::enable_if_t<!detail::IsInstrumentedSelf<Instrumented, Ts...>::value &&
+                                          std::is_constructible<T, Ts &&...>::value>>
+    Instrumented(Ts &&...params) : T(std::forward<Ts>(params)...)
+    {
+        count(&InstrumentCounts::constructed);
+    }
+
+    Instrumented(const Instrumented &rhs) : T(static_cast<const T &>(rhs))
+    {
+        count(&InstrumentCounts::copied);
+    }
+
+    Instrumented(Instrumented &&rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+        : T(static_cast<T &&>(rhs))
+    {
+        count(&InstrumentCounts::moved);
+    }
+
+    Instrumented &operator=(const Instrumented &rhs)
+    {
+        T::operator=(static_cast<const T &>(rhs));
+        count(&InstrumentCounts::copyAssigned);
+        return *this;
+    }
+
+    Instrumented &operator=(Instrumented &&rhs) noexcept(std::is_nothrow_move_assignable<T>::value)
+    {
+        T::operator=(static_cast<T &&>(rhs));
+        count(&InstrumentCounts::moveAssigned);
+        return *this;
+    }
+
+    ~Instrumented() { count(&InstrumentCounts::destroyed); }
+
+    static const InstrumentCounts &counts() { return detail::instrumentedType<T>().counts; }
+
+private:
+    static void count(std::atomic<std::uint64_t> InstrumentCounts::*which) noexcept
+    {
+        detail::count(detail::instrumentedType<T>().counts, which);
+    }
+};
+
+#if defined(INSTRUMENT_ALLOCATIONS)
+
+namespace detail
+{
+    inline void *instrumentedAllocate(std::size_t size)
+    {
+        if (InstrumentSite *site = currentSite())
+        {
+            site->counts.allocations.fetch_add(1, std::memory_order_relaxed);
+            site->counts.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+        for (;;)
+        {
+            if (void *p = std::malloc(size ? size : 1))
+                return p;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc();
+            handler();
+        }
+    }
+}
+
+void *operator new(std::size_t size) { return detail::instrumentedAllocate(size); }
+void *operator new[](std::size_t size) { return detail::instrumentedAllocate(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+#endif
@@ -3,6 +3,15 @@
 #include <iostream>
 #include <tuple>
 #include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "column_table.h"
+#include "enum_map.h"
+#include "packed_enum_array.h"
 
 enum Status : std::uint8_t
 {
@@ -12,6 +21,30 @@ enum Status : std::uint8_t
     corrupt = 66,
 };
 
+// Status is sparse (0, 1, 65, 66), so packed arrays store codes 0 to 3
+// instead: two bits per Status
+template <>
+struct PackedEnumCodes<Status>
+{
+    static constexpr unsigned encode(Status s) noexcept
+    {
+        return s < incomplete ? s : s - incomplete + 2;
+    }
+
+    static constexpr Status decode(unsigned code) noexcept
+    {
+        return static_cast<Status>(code + (code >> 1) * (incomplete - 2)); // 0 1 65 66
+    }
+};
+
+enum class Color
+{
+    red,
+    blue,
+    green
+};
+REFLECT_ENUM(Color, red, blue, green);
+
 // enum Responses; // error
 enum class Message;
 
@@ -46,7 +79,186 @@ toUType(E enumerator) noexcept
     return static_cast<std::underlying_type_t<E>>(enumerator);
 }
 
-int main()
+// best of a few runs, in nanoseconds per row
+template <typename F>
+double nsPerRow(std::size_t rows, F f)
+{
+    double best = measureNs(f);
+    for (int run = 0; run != 2; ++run)
+        best = std::min(best, measureNs(f));
+    return best / rows;
+}
+
+// Item 10's user records as a vector of tuples and as a ColumnTable; Name,
+// Email and Reputation are the field indices (the UserInfoFields
+// enumerators at the call site)
+template <std::size_t Name, std::size_t Email, std::size_t Reputation>
+void benchmarkUserTable(std::size_t n)
+{
+    using UserInfo = std::tuple<std::string, std::string, std::size_t>;
+
+    std::vector<UserInfo> rows;
+    rows.reserve(n);
+    ColumnTable<std::string, std::string, std::size_t> table;
+
+    std::mt19937 rng(10);
+    std::uniform_int_distribution<std::size_t> reputation(0, 99999);
+    for (std::size_t i = 0; i != n; ++i)
+    {
+        std::string name = "user" + std::to_string(i);
+        std::string email = name + "@example.com";
+        std::size_t r = reputation(rng);
+        table.push_back(name, email, r);
+        rows.emplace_back(std::move(name), std::move(email), r);
+    }
+
+    const auto &rep = table.template column<Reputation>();
+    const std::size_t threshold = 99900; // the top 0.1%
+    std::size_t results[2] = {};
+
+    std::cout << n << " users (ns per user, rows vs columns)\n";
+
+    auto report = [&](const char *what, double aos, double soa)
+    {
+        std::cout << "  " << what << aos << " vs " << soa
+                  << (results[0] == results[1] ? "" : " (results differ!)") << '\n';
+    };
+
+    report("sum of reputations:      ",
+           nsPerRow(n, [&]
+                    {
+        std::size_t sum = 0;
+        for (const auto &u : rows)
+            sum += std::get<Reputation>(u);
+        doNotOptimize(results[0] = sum); }),
+           nsPerRow(n, [&]
+                    {
+        std::size_t sum = 0;
+        for (std::size_t r : rep)
+            sum += r;
+        doNotOptimize(results[1] = sum); }));
+
+    report("count top reputations:   ",
+           nsPerRow(n, [&]
+                    {
+        std::size_t count = 0;
+        for (const auto &u : rows)
+            count += std::get<Reputation>(u) >= threshold;
+        doNotOptimize(results[0] = count); }),
+           nsPerRow(n, [&]
+                    { doNotOptimize(results[1] = countWhere(rep, [=](std::size_t r)
+                                                            { return r >= threshold; })); }));
+
+    // select the top users, then read their names
+    report("top names, total length: ",
+           nsPerRow(n, [&]
+                    {
+        std::size_t length = 0;
+        for (const auto &u : rows)
+            if (std::get<Reputation>(u) >= threshold)
+                length += std::get<Name>(u).size();
+        doNotOptimize(results[0] = length); }),
+           nsPerRow(n, [&]
+                    {
+        std::size_t length = 0;
+        for (std::size_t row : selectWhere(rep, [=](std::size_t r)
+                                           { return r >= threshold; }))
+            length += table.template get<Name>(row).size;
+        doNotOptimize(results[1] = length); }));
+
+    const std::string last = "user" + std::to_string(n - 1) + "@example.com";
+    report("find the last email:     ",
+           nsPerRow(n, [&]
+                    {
+        std::size_t row = 0;
+        while (row != n && std::get<Email>(rows[row]) != last)
+            ++row;
+        doNotOptimize(results[0] = row); }),
+           nsPerRow(n, [&]
+                    { doNotOptimize(results[1] = table.template column<Email>().find(
+                                        StringRef{last.data(), last.size()})); }));
+
+    // strings that don't fit the small-string buffer have a heap block too
+    std::size_t rowBytes = rows.capacity() * sizeof(UserInfo);
+    for (const auto &u : rows)
+        for (const std::string *s : {&std::get<Name>(u), &std::get<Email>(u)})
+            if (s->capacity() > std::string().capacity())
+                rowBytes += s->capacity() + 1;
+    std::size_t columnBytes = table.template column<Name>().bytes() +
+                              table.template column<Email>().bytes() +
+                              rep.capacity() * sizeof(std::size_t);
+    std::cout << "  memory: " << rowBytes / n << " vs " << columnBytes / n << " bytes per user\n";
+}
+
+// n random statuses (no corrupt one before 7n/8) in a byte per element
+// and packed two bits per element
+void benchmarkPackedStatus(std::size_t n)
+{
+    std::vector<Status> bytes(n);
+    PackedEnumArray<Status, 2> packed(n);
+
+    std::mt19937 rng(10);
+    const Status common[] = {good, good, good, failed, incomplete};
+    for (std::size_t i = 0; i != n; ++i)
+    {
+        Status s = i == n / 8 * 7 ? corrupt : common[rng() % 5];
+        bytes[i] = s;
+        packed.set(i, s);
+    }
+
+    std::size_t results[2] = {};
+    auto report = [&](const char *what, double unpacked, double twoBits)
+    {
+        std::cout << "  " << what << unpacked << " vs " << twoBits
+                  << (results[0] == results[1] ? "" : " (results differ!)") << '\n';
+    };
+
+    std::cout << n << " statuses (ns per element, bytes vs 2 bits)\n"
+              << "  memory: " << bytes.capacity() << " vs " << packed.bytes() << " bytes\n";
+
+    report("count(incomplete):   ",
+           nsPerRow(n, [&]
+                    { doNotOptimize(results[0] = std::count(bytes.begin(), bytes.end(), incomplete)); }),
+           nsPerRow(n, [&]
+                    { doNotOptimize(results[1] = packed.count(incomplete)); }));
+
+    report("histogram:           ",
+           nsPerRow(n, [&]
+                    {
+        std::size_t counts[256] = {};
+        for (Status s : bytes)
+            ++counts[s];
+        doNotOptimize(results[0] = counts[good] * 3 + counts[failed] * 5 + counts[incomplete] * 7); }),
+           nsPerRow(n, [&]
+                    {
+        auto counts = packed.histogram();
+        auto code = [](Status s)
+        { return PackedEnumCodes<Status>::encode(s); };
+        doNotOptimize(results[1] = counts[code(good)] * 3 + counts[code(failed)] * 5 +
+                                   counts[code(incomplete)] * 7); }));
+
+    report("findFirst(corrupt):  ",
+           nsPerRow(n, [&]
+                    { doNotOptimize(results[0] = std::find(bytes.begin(), bytes.end(), corrupt) - bytes.begin()); }),
+           nsPerRow(n, [&]
+                    { doNotOptimize(results[1] = packed.findFirst(corrupt)); }));
+
+    report("element by element:  ",
+           nsPerRow(n, [&]
+                    {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i != n; ++i)
+            sum += bytes[i];
+        doNotOptimize(results[0] = sum); }),
+           nsPerRow(n, [&]
+                    {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i != n; ++i)
+            sum += packed[i];
+        doNotOptimize(results[1] = sum); }));
+}
+
+int main(int argc, char *argv[])
 {
     enum Food
     {
@@ -58,12 +270,8 @@ int main()
     // error - scoped enum
     // auto meat = false;
 
-    enum class Color
-    {
-        red,
-        blue,
-        green
-    };
+    // enum class Color { red, blue, green }; is declared above main, where
+    // REFLECT_ENUM can describe it
 
     // fine - unscoped enum by the name class (cpp 11)
 
@@ -85,6 +293,23 @@ int main()
 
     std ::cout << blue << ' ' << food << ' ' << corrupt << '\n';
 
+    // a handful of enumerators need only a couple of bits each
+    PackedEnumArray<Color, 2> colors(5, Color::green);
+    colors.set(1, color1);
+    PackedEnumArray<Food, 2> foods;
+    foods.push_back(cheese);
+    foods.push_back(food);
+    std ::cout << toUType(colors[1]) << ' ' << colors.count(Color::green) << ' '
+               << colors.findFirst(Color::blue) << ' ' << foods.histogram()[cheese] << '\n';
+
+    // toUType turns a scoped enumerator into an array index, so a map keyed by
+    // Color is just an array with a slot per color
+    EnumMap<Color, int> wavelength{{Color::red, 700}, {Color::blue, 470}, {Color::green, 530}};
+    EnumSet<Color> seen{color1, Color::green};
+    wavelength.forEach([&](Color c, int nm)
+                       { std ::cout << enumName(c) << '=' << nm << (seen.contains(c) ? "* " : " "); });
+    std ::cout << EnumTraits<Color>::count() << " colors\n";
+
     // useful unscoped enum
     enum UserInfoFields
     {
@@ -112,6 +337,24 @@ int main()
 
     auto val1 = std::get<toUType(UserInfoFields1::uiEmail)>(uInfo);
 
+    // one column per field, addressed the same way
+    ColumnTable<std ::string, std ::string, std ::size_t> users;
+    users.push_back(std ::string("Scott"), std ::string("scott@example.com"), 1000);
+    users.push_back(uInfo);
+    std ::cout << users.get<uiName>(0).str() << ' '
+               << users.get<toUType(UserInfoFields1::uiReputation)>(0) << ' '
+               << std ::get<uiEmail>(users.row(0)) << ' ' << users.size() << '\n';
+
+    // scans over one field: argv[1] users (default 2 million)
+    std ::size_t userCount = argc > 1 ? std ::strtoull(argv[1], nullptr, 10) : 2000000;
+    if (userCount > 0)
+        benchmarkUserTable<uiName, uiEmail, uiReputation>(userCount);
+
+    // scans over argv[2] statuses (default 2^26)
+    std ::size_t statusCount = argc > 2 ? std ::strtoull(argv[2], nullptr, 10) : std ::size_t(1) << 26;
+    if (statusCount > 0)
+        benchmarkPackedStatus(statusCount);
+
     return 0;
 }
 
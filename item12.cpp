@@ -2,8 +2,16 @@
 
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "bench.h"
+#include "buffer_pool.h"
+#include "static_dispatch.h"
+
 class Widget
 {
 public:
@@ -13,10 +21,16 @@ public:
                       // only when *this is an rvalue
 };
 
+// When the vector that data() && hands out is used once and dropped, every
+// Widget1 pays for a fresh allocation. With a PooledVector the buffer goes
+// back to a pool instead, and the next Widget1 picks it up again.
 class Widget1
 {
 public:
-    using DataType = std::vector<double>;
+    using DataType = PooledVector<double>;
+
+    Widget1() = default;
+    explicit Widget1(DataType values) : values(std::move(values)) {}
 
     DataType &data() & // for lvalue Widgets,
     {
@@ -34,7 +48,11 @@ private:
 class Base
 {
 public:
+    virtual ~Base() = default; // the benchmark deletes through a Base*
     virtual void doWork(); // base class virtual function
+
+protected:
+    std::size_t workDone = 0;
 };
 
 class Derived : public Base
@@ -45,8 +63,98 @@ public:
     // ("virtual" is optional
 }; // here)
 
-void Base::doWork() {}
-void Derived::doWork() {}
+void Base::doWork() { workDone += 1; }
+void Derived::doWork() { workDone += 2; }
+
+// more overrides, for dispatch over more than two types
+template <std::size_t I>
+class DerivedN : public Base
+{
+public:
+    void doWork() override { workDone += I + 1; }
+};
+
+template <std::size_t I>
+using Kind = std::conditional_t<I == 0, Base,
+                                std::conditional_t<I == 1, Derived, DerivedN<I>>>;
+
+// Calls doWork on a million objects of `sizeof...(Is)` types three ways:
+// virtually through unique_ptr<Base>, by visiting a Variant holding the
+// objects by value, and over a batch sorted by dynamic type. In the last two
+// the qualified call x.T::doWork() reaches the very same override, but
+// statically.
+template <std::size_t... Is>
+void benchmarkDispatch(std::index_sequence<Is...>)
+{
+    constexpr std::size_t count = 1'000'000;
+    using Object = Variant<Kind<Is>...>;
+
+    std::unique_ptr<Base> (*makePointer[])() = {[]
+                                                { return std::unique_ptr<Base>(std::make_unique<Kind<Is>>()); }...};
+    Object (*makeObject[])() = {[]
+                                { return Object(Kind<Is>()); }...};
+
+    std::vector<std::unique_ptr<Base>> pointers;
+    std::vector<Object> objects;
+    std::mt19937 gen(12);
+    std::uniform_int_distribution<std::size_t> pick(0, sizeof...(Is) - 1);
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        auto kind = pick(gen);
+        pointers.push_back(makePointer[kind]());
+        objects.push_back(makeObject[kind]());
+    }
+
+    auto callDoWork = [](auto &x)
+    {
+        using T = std::decay_t<decltype(x)>;
+        x.T::doWork(); // no virtual dispatch
+    };
+
+    auto virtualNs = measureNs([&]
+                               {
+        for (auto &p : pointers)
+            p->doWork(); });
+    auto variantNs = measureNs([&]
+                               {
+        for (auto &obj : objects)
+            obj.visit(callDoWork); });
+
+    TypeSortedBatch<Base, Kind<Is>...> batch(pointers); // sorted once
+    auto sortedNs = measureNs([&]
+                              { batch.forEach(callDoWork); });
+
+    std::cout << sizeof...(Is) << " types: virtual " << virtualNs / count
+              << ", variant " << variantNs / count
+              << ", sorted batch " << sortedNs / count << " ns per call\n";
+}
+
+// produce -> scale -> sum, with the data moved along as an rvalue the whole
+// way; returns ns per run of the pipeline
+template <typename MakeData, typename Scale, typename Sum>
+double pipelineNs(std::size_t runs, MakeData makeData, Scale scale, Sum sum)
+{
+    double total = 0;
+    auto ns = measureNs([&]
+                        {
+        for (std::size_t r = 0; r != runs; ++r)
+            total += sum(scale(makeData())); });
+    doNotOptimize(total);
+    return ns / runs;
+}
+
+// Buffers released after the releasing thread's pool cache is gone: the
+// thread_local below is constructed before the cache and so destroyed after
+// it, and lateWidget's buffer is given back during static destruction.
+// Both go to the pool's shared list.
+Widget1 lateWidget;
+
+void releaseLate()
+{
+    thread_local Widget1::DataType late;
+    late = Widget1::DataType::withCapacity(1024); // sets up the cache
+    late.push_back(1);
+}
 
 int main()
 {
@@ -59,6 +167,67 @@ int main()
     // class ptr; derived class
     // function is invoked
 
+    // 512 KiB buffers, which malloc recycles well by itself, and 64 MiB ones,
+    // which malloc maps and unmaps (and page-faults in) every single time
+    for (std::size_t n : {std::size_t(1) << 16, std::size_t(1) << 23})
+    {
+        const std::size_t runs = (std::size_t(1) << 27) / n;
+
+        auto plain = pipelineNs(
+            runs,
+            [n]
+            {
+                std::vector<double> values;
+                values.reserve(n);
+                for (std::size_t i = 0; i != n; ++i)
+                    values.push_back(i);
+                return values;
+            },
+            [](std::vector<double> values)
+            {
+                for (auto &x : values)
+                    x *= 2;
+                return values;
+            },
+            [](std::vector<double> values)
+            { return std::accumulate(values.begin(), values.end(), 0.0); });
+
+        auto pooled = pipelineNs(
+            runs,
+            [n]
+            {
+                Widget1 w(Widget1::DataType::withCapacity(n));
+                for (std::size_t i = 0; i != n; ++i)
+                    w.data().push_back(i); // lvalue: data() &
+                return w;
+            },
+            [](Widget1 w)
+            {
+                for (auto &x : w.data())
+                    x *= 2;
+                return Widget1(std::move(w).data()); // rvalue: data() &&
+            },
+            [](Widget1 w)
+            {
+                auto values = std::move(w).data();
+                return std::accumulate(values.begin(), values.end(), 0.0);
+            }); // values' buffer goes back to the pool here
+
+        std::cout << n << " doubles: std::vector pipeline " << plain / n << " ns, "
+                  << "pooled Widget1 pipeline " << pooled / n << " ns per element\n";
+    }
+
+    auto &pool = BufferPool<double>::instance();
+    std::cout << "pool hits " << pool.hits() << ", misses " << pool.misses() << '\n';
+    pool.trim();
+
+    std::thread(releaseLate).join();
+    lateWidget = Widget1(Widget1::DataType::withCapacity(1024));
+
+    benchmarkDispatch(std::make_index_sequence<2>());
+    benchmarkDispatch(std::make_index_sequence<8>());
+    benchmarkDispatch(std::make_index_sequence<32>());
+
     return 0;
 }
 
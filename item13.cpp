@@ -3,6 +3,18 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+
+#include "bench.h"
+#include "chunked_sequence.h"
+#include "output_sink.h"
+#include "parallel_find.h"
+
+using seq::ChunkedSequence;
 
 // This works fine in C++14, but, sadly, not in C++11. Through an oversight during
 // standardization, C++11 added the non-member functions begin and end, but it
@@ -21,6 +33,62 @@ void findAndInsert(C &container,       // in container, find
     container.insert(it, insertVal);
 }
 
+// When the container is known to be sorted, the search doesn't have to be
+// linear. The caller vouches for that by passing sortedRange; the first
+// occurrence of targetVal is then found by binary search, through the
+// container's own lower_bound when it has one (std::set, std::multiset,
+// ChunkedSequence) and std::lower_bound on cbegin/cend otherwise.
+struct SortedRange
+{
+    explicit SortedRange() = default;
+};
+constexpr SortedRange sortedRange{};
+
+template <typename C, typename V>
+auto sortedLowerBound(const C &container, const V &value, int)
+    -> decltype(container.lower_bound(value))
+{
+    return container.lower_bound(value);
+}
+
+template <typename C, typename V>
+auto sortedLowerBound(const C &container, const V &value, long)
+{
+    using std::cbegin;
+    using std::cend;
+    return std::lower_bound(cbegin(container), cend(container), value);
+}
+
+template <typename C, typename V>
+void findAndInsert(SortedRange,
+                   C &container,
+                   const V &targetVal,
+                   const V &insertVal)
+{
+    using std::cbegin;
+    using std::cend;
+    assert(std::is_sorted(cbegin(container), cend(container)));
+
+    auto it = sortedLowerBound(container, targetVal, 0); // int: prefer the member
+    if (it != cend(container) && targetVal < *it)        // no targetVal: append,
+        it = cend(container);                            // just like std::find
+    container.insert(it, insertVal);
+}
+
+// For very large containers: the same search, split across a thread pool
+// (SIMD-scanned when the elements are arithmetic and contiguous)
+template <typename C, typename V>
+void findAndInsert(ThreadPool &pool,
+                   C &container,
+                   const V &targetVal,
+                   const V &insertVal)
+{
+    using std::cbegin;
+    using std::cend;
+    auto it = parallelFind(pool, cbegin(container), cend(container), targetVal);
+    container.insert(it, insertVal);
+}
+
 // If you’re using C++11, you want to write maximally generic code, and none of the
 // libraries you’re using provides the missing templates for non-member cbegin and
 // friends, you can throw your own implementations together with ease. For example,
@@ -31,7 +99,94 @@ auto cbegin(const C &container) -> decltype(std::begin(container))
     return std::begin(container); // see explanation below
 }
 
-int main()
+// n sorted even numbers, then `inserts` calls of insert(c, target, target - 1)
+// for random targets already present, which keeps the sequence sorted;
+// returns nanoseconds per insert
+template <typename C, typename Insert>
+double bulkInsertNs(std::size_t n, std::size_t inserts, Insert insert)
+{
+    C container;
+    for (std::size_t i = 0; i != n; ++i)
+        container.push_back(static_cast<int>(2 * i));
+
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+    std::vector<int> targets(inserts);
+    for (auto &t : targets)
+        t = static_cast<int>(2 * pick(rng));
+
+    double ns = measureNs([&]
+                          {
+        for (int t : targets)
+            insert(container, t, t - 1); });
+
+    using std::cbegin;
+    using std::cend;
+    if (container.size() != n + inserts || !std::is_sorted(cbegin(container), cend(container)))
+        std::cout << "  (bulk insert left the sequence unsorted!)\n";
+    return ns / inserts;
+}
+
+void benchmarkFindAndInsert(std::size_t n, std::size_t inserts)
+{
+    auto linear = [](auto &c, int t, int v)
+    { findAndInsert(c, t, v); };
+    auto sorted = [](auto &c, int t, int v)
+    { findAndInsert(sortedRange, c, t, v); };
+
+    std::cout << n << " elements, " << inserts << " inserts (ns per insert)\n"
+              << "  vector, std::find:                " << bulkInsertNs<std::vector<int>>(n, inserts, linear) << '\n'
+              << "  vector, lower_bound:              " << bulkInsertNs<std::vector<int>>(n, inserts, sorted) << '\n'
+              << "  ChunkedSequence, lower_bound:     " << bulkInsertNs<ChunkedSequence<int>>(n, inserts, sorted) << '\n';
+}
+
+// best of a few runs, in nanoseconds
+template <typename F>
+double bestOfNs(int runs, F f)
+{
+    double best = measureNs(f);
+    while (--runs > 0)
+        best = std::min(best, measureNs(f));
+    return best;
+}
+
+void benchmarkParallelFind(std::size_t n)
+{
+    std::vector<int> values(n);
+    for (std::size_t i = 0; i != n; ++i)
+        values[i] = static_cast<int>(i % 1000);
+
+    auto gbps = [n](double ns)
+    { return n * sizeof(int) / ns; };
+
+    std::cout << n << " ints, target absent (GB/s scanned)\n"
+              << "  std::find:                 "
+              << gbps(bestOfNs(3, [&]
+                               { doNotOptimize(std::find(values.cbegin(), values.cend(), -1)); }))
+              << '\n';
+
+    // a match an eighth of the way in: the chunks behind it are never
+    // searched, so that search should take about 1/8 of the full scan
+    values[n / 8] = -2;
+
+    for (unsigned threads = 1; threads <= ThreadPool::defaultThreads(); ++threads)
+    {
+        ThreadPool pool(threads - 1); // plus the calling thread
+        double full = bestOfNs(3, [&]
+                               { doNotOptimize(parallelFind(pool, values.cbegin(), values.cend(), -1)); });
+        double early = bestOfNs(3, [&]
+                                { doNotOptimize(parallelFind(pool, values.cbegin(), values.cend(), -2)); });
+        std::cout << "  parallelFind, " << threads << " thread(s): " << gbps(full)
+                  << " (match at n/8: " << early / full << " of the time)\n";
+    }
+
+    ThreadPool pool;
+    findAndInsert(pool, values, -2, 1998);
+    if (values[n / 8] != 1998 || values[n / 8 + 1] != -2)
+        std::cout << "  (parallel findAndInsert inserted at the wrong place!)\n";
+}
+
+int main(int argc, char *argv[])
 {
     // std ::vector<int> values{1983};
     std ::vector<int> values;
@@ -42,8 +197,10 @@ int main()
 
     values.insert(it, 1998);
 
+    auto &out = stdoutSink();
     for (const int &x : values)
-        std ::cout << x << ' ' << &x << '\n';
+        out << x << ' ' << &x << '\n';
+    out.flush(); // before std::cout takes over again
 
     // Const iterators in CPP 98 weren't practical
 
@@ -54,6 +211,35 @@ int main()
 
     values1.insert(it1, 1998);
 
+    // the generic findAndInsert works on anything with cbegin/cend and
+    // insert(const_iterator, value), a ChunkedSequence included
+    ChunkedSequence<int> chunks{1983, 2011, 2014};
+    findAndInsert(chunks, 2011, 1998);
+    for (int x : chunks)
+        std ::cout << x << ' ';
+    std ::cout << '\n';
+
+    // ...and the sorted overload is logarithmic on sorted containers
+    std ::multiset<std::string> words{"auto", "const", "decltype", "noexcept"};
+    findAndInsert(sortedRange, words, std::string("decltype"), std::string("constexpr"));
+    std ::vector<int> years{1983, 1998, 2011, 2014};
+    findAndInsert(sortedRange, years, 2014, 2013);
+    findAndInsert(sortedRange, chunks, 2014, 2013);
+    std ::cout << words.size() << " words, last year before 2014: " << years[3]
+               << ' ' << chunks[3] << '\n';
+
+    // bulk inserts into a sorted sequence: argv[1] elements (default 10^6),
+    // argv[2] inserts (default 2000); try 100000000 for the 10^8 case
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::size_t inserts = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000;
+    if (n > 0 && inserts > 0)
+        benchmarkFindAndInsert(n, inserts);
+
+    // parallel linear search over argv[3] ints (default 2^24)
+    std::size_t searched = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : std::size_t(1) << 24;
+    if (searched > 0)
+        benchmarkParallelFind(searched);
+
     return 0;
 }
 
@@ -5,6 +5,12 @@
 #include <thread>
 #include <atomic>
 #include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include "bench.h"
+#include "trace.h"
+#include "work_stealing_pool.h"
 
 using namespace std;
 
@@ -14,6 +20,7 @@ public:
     using RootsType = std::vector<double>;
     RootsType roots() const
     {
+        TRACE_SCOPE("Polynomial::roots");
         std::lock_guard<std::mutex> g(m); // lock mutex
         if (!rootsAreValid)
         { // if cache not valid
@@ -47,6 +54,7 @@ private:
 
 int expensiveComputation1()
 {
+    TRACE_SCOPE("expensiveComputation1");
     int x = 0;
     for (int i = 0; i < 1e6; i++)
         x++;
@@ -56,6 +64,7 @@ int expensiveComputation1()
 
 int expensiveComputation2()
 {
+    TRACE_SCOPE("expensiveComputation2");
     int x = 0;
     for (int i = 0; i < 1e6; i++)
         x++;
@@ -68,13 +77,17 @@ class Widget
 public:
     int magicValue() const
     {
+        TRACE_SCOPE("Widget::magicValue");
         std::lock_guard<std::mutex> guard(m); // lock m
         if (cacheValid)
             return cachedValue;
         else
         {
-            auto val1 = expensiveComputation1();
-            auto val2 = expensiveComputation2();
+            int val1, val2; // computed side by side
+            sharedPool().join([&]
+                              { val1 = expensiveComputation1(); },
+                              [&]
+                              { val2 = expensiveComputation2(); });
             cachedValue = val1 + val2;
             cacheValid = true;
             return cachedValue;
@@ -86,9 +99,121 @@ private:
     mutable bool cacheValid{false}; // no longer atomic
 };
 
-int main()
+long fib(int n)
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+// forks down to fib(16), below which a fork costs more than it saves
+long parallelFib(WorkStealingPool &pool, int n)
+{
+    if (n <= 16)
+        return fib(n);
+    long a, b;
+    pool.join([&]
+              { a = parallelFib(pool, n - 1); },
+              [&]
+              { b = parallelFib(pool, n - 2); });
+    return a + b;
+}
+
+// best of three, in milliseconds
+template <typename F>
+double bestMs(F f)
+{
+    double best = measureNs(f);
+    for (int run = 0; run != 2; ++run)
+        best = std::min(best, measureNs(f));
+    return best / 1e6;
+}
+
+// fib(n) and a sum of `elements` ints, serially and on pools of 1, 2, 4, ...
+// up to maxThreads workers
+void benchmarkForkJoin(int n, std::size_t elements, unsigned maxThreads)
+{
+    std::vector<int> values(elements);
+    for (std::size_t i = 0; i != elements; ++i)
+        values[i] = static_cast<int>(i % 1000);
+    auto sum = [&values](std::size_t lo, std::size_t hi)
+    {
+        long s = 0;
+        for (std::size_t i = lo; i != hi; ++i)
+            s += values[i];
+        return s;
+    };
+
+    long results[2] = {};
+    double serialFib = bestMs([&]
+                              { doNotOptimize(results[0] = fib(n)); });
+    double serialSum = bestMs([&]
+                              { doNotOptimize(results[1] = sum(0, elements)); });
+    std::cout << "fork-join: fib(" << n << ") and a sum of " << elements
+              << " ints (ms, speedup)\n"
+              << "  serial:      fib " << serialFib << ", sum " << serialSum << '\n';
+
+    for (unsigned threads = 1;; threads = std::min(threads * 2, maxThreads))
+    {
+        WorkStealingPool pool(threads);
+        long fibResult = 0, sumResult = 0;
+        double fibMs = bestMs([&]
+                              { fibResult = pool.run([&]
+                                                     { return parallelFib(pool, n); }); });
+        double sumMs = bestMs([&]
+                              { sumResult = pool.parallelReduce(std::size_t(0), elements, std::size_t(1) << 16, 0L,
+                                                                sum, [](long a, long b)
+                                                                { return a + b; }); });
+        std::cout << "  " << threads << (threads == 1 ? " thread:    " : " threads:   ")
+                  << "fib " << fibMs << " (" << serialFib / fibMs << "x), sum " << sumMs
+                  << " (" << serialSum / sumMs << "x)"
+                  << (fibResult == results[0] && sumResult == results[1] ? "" : " (results differ!)")
+                  << '\n';
+        if (threads == maxThreads)
+            break;
+    }
+}
+
+int main(int argc, char *argv[])
 {
     std::cout << __cplusplus << endl;
 
+    // what a span costs; those spans aren't worth keeping
+    const int spans = 1000000;
+    double ns = measureNs([]
+                          {
+        for (int i = 0; i != spans; ++i)
+        {
+            TRACE_SCOPE("empty");
+        } });
+    trace::clear();
+    std::cout << "TRACE_SCOPE: " << ns / spans << " ns per span\n";
+
+    // one thread computes the cached value, the others wait for it on m
+    {
+        TRACE_SCOPE("magicValue from 4 threads");
+        Widget w;
+        Polynomial p;
+        std::vector<std::thread> threads;
+        for (int i = 0; i != 4; ++i)
+            threads.emplace_back([&]
+                                 {
+                w.magicValue();
+                p.roots(); });
+        for (auto &t : threads)
+            t.join();
+    }
+
+    // TRACE_JSON=item16.trace.json item16 exports the spans
+    if (const char *path = std::getenv("TRACE_JSON"))
+        if (trace::writeJson(path))
+            std::cout << "wrote " << path << '\n';
+
+    // fib(argv[1]) (default 36) and a sum of argv[2] ints (default 2^25),
+    // on up to argv[3] threads (default: one per core)
+    int n = argc > 1 ? std::atoi(argv[1]) : 36;
+    std::size_t elements = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::size_t(1) << 25;
+    unsigned maxThreads = argc > 3 ? std::atoi(argv[3]) : WorkStealingPool::defaultThreads();
+    if (n > 0 && elements > 0 && maxThreads > 0)
+        benchmarkForkJoin(n, elements, maxThreads);
+
     return 0;
 }
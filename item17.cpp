@@ -1,5 +1,11 @@
 // Item 17: Understand special member function generation.
 #include <iostream>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+#include "relocatable.h"
 
 using namespace std;
 
@@ -53,6 +59,38 @@ public:
     Base &operator=(const Base &) = default;
 };
 
+// Base's special members are all defaulted, so moving one and destroying the
+// source is a byte copy, vptr included. C++14 can't tell a defaulted move
+// from a user-written one once the class is polymorphic, so Base says so
+// itself; trivially copyable classes need no such line.
+template <>
+struct is_trivially_relocatable<Base> : std::true_type
+{
+};
+
+static_assert(is_trivially_relocatable<Base>::value, "");
+static_assert(is_trivially_relocatable<unique_ptr<Base>>::value, "");
+static_assert(!is_trivially_relocatable<Widget1>::value, "user-declared destructor");
+
+// fills a vector with n unique_ptrs; growing it is what we time
+template <typename Vector>
+double fillNs(size_t n)
+{
+    return measureNs([n]
+                     {
+        Vector v;
+        for (size_t i = 0; i != n; ++i)
+            v.push_back(unique_ptr<Base>());
+        doNotOptimize(v.data()); });
+}
+
+void benchmarkReallocation(size_t n)
+{
+    double ns[2] = {fillNs<vector<unique_ptr<Base>>>(n), fillNs<relocating_vector<unique_ptr<Base>>>(n)};
+    cout << n << " unique_ptr<Base> push_backs (ns per element): std::vector " << ns[0] / n
+         << ", relocating_vector " << ns[1] / n << '\n';
+}
+
 // The C++11 rules governing the special member functions are thus:
 // • Default constructor: Same rules as C++98. Generated only if the class contains
 // no user-declared constructors.
@@ -73,7 +111,7 @@ public:
 // moving of non-static data members. Generated only if the class contains no userdeclared
 // copy operations, move operations, or destructor.
 
-int main()
+int main(int argc, char *argv[])
 {
     A a;
     A a1{};
@@ -81,6 +119,12 @@ int main()
     // ok but deprecated
     // A a2{a};
 
+    // argv[1] elements (default 1 million; 100 million, where growing the
+    // buffer costs the most, needs a few GiB)
+    size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    if (n > 0)
+        benchmarkReallocation(n);
+
     return 0;
 }
 
@@ -1,28 +1,131 @@
 /// Item 18: Use std::unique_ptr for exclusive-ownership resource management.
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <locale>
 #include <memory>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "async_file_reader.h"
+#include "bench.h"
+#include "mapped_file.h"
+#include "poly_collection.h"
+#include "trace.h"
+
+// cmake -DCXX17_PMR=ON
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#define ITEM18_PMR 1
+#endif
 
 using namespace std;
 
 class Investment
 {
+public:
+    virtual ~Investment() = default; // essential design component!
+    virtual double value() const { return 0; }
 };
-class Stock : public Investment
+
+// final, so a call through a Stock& (rather than an Investment&)
+// needs no virtual dispatch
+class Stock final : public Investment
 {
+public:
+    explicit Stock(double amount = 0) : shares(amount / 100), price(100) {}
+    double value() const override { return shares * price; }
+
+private:
+    double shares, price;
 };
-class Bond : public Investment
+class Bond final : public Investment
 {
+public:
+    explicit Bond(double amount = 0) : face(amount), rate(0.05) {}
+    double value() const override { return face * (1 + rate); }
+
+private:
+    double face, rate;
 };
-class RealEstate : public Investment
+class RealEstate final : public Investment
+{
+public:
+    explicit RealEstate(double amount = 0) : price(amount), mortgage(amount / 2) {}
+    double value() const override { return price - mortgage; }
+
+private:
+    double price, mortgage;
+};
+
+enum class InvestmentKind
+{
+    Stock,
+    Bond,
+    RealEstate
+};
+
+std::size_t logEntries = 0;
+
+void makeLogEntry(const Investment *)
+{
+    ++logEntries;
+}
+
+template <typename... Ts>
+auto makeInvestment(InvestmentKind kind, Ts &&...params) // C++14
+{
+    auto delInvmt = [](Investment *pInvestment)
+    {
+        makeLogEntry(pInvestment);
+        delete pInvestment;
+    };
+    std::unique_ptr<Investment, decltype(delInvmt)>
+        pInv(nullptr, delInvmt);
+    if (kind == InvestmentKind::Stock)
+    {
+        pInv.reset(new Stock(std::forward<Ts>(params)...));
+    }
+    else if (kind == InvestmentKind::Bond)
+    {
+        pInv.reset(new Bond(std::forward<Ts>(params)...));
+    }
+    else if (kind == InvestmentKind::RealEstate)
+    {
+        pInv.reset(new RealEstate(std::forward<Ts>(params)...));
+    }
+    return pInv;
+}
+
+// A portfolio of millions of Investments is better off without a heap object
+// (and a virtual call) per Investment: each concrete type gets a contiguous
+// segment, and destroying an element still goes through makeLogEntry, just
+// like delInvmt does.
+struct LogInvestment
 {
+    void operator()(const Investment *pInvestment) const { makeLogEntry(pInvestment); }
 };
 
+using Portfolio = PolyCollection<Investment, LogInvestment, Stock, Bond, RealEstate>;
+
+template <typename... Ts>
+Investment &addInvestment(Portfolio &portfolio, InvestmentKind kind, Ts &&...params)
+{
+    if (kind == InvestmentKind::Stock)
+        return portfolio.emplace<Stock>(std::forward<Ts>(params)...);
+    else if (kind == InvestmentKind::Bond)
+        return portfolio.emplace<Bond>(std::forward<Ts>(params)...);
+    else
+        return portfolio.emplace<RealEstate>(std::forward<Ts>(params)...);
+}
+
 // template <typename... Ts>
 // auto makeInvestment(Ts &&...params) // C++14
 // {
@@ -80,13 +183,38 @@ void close_file(std::FILE *fp)
 // unique_ptr-based linked list demo
 struct List
 {
+    struct Node;
+#if defined(ITEM18_PMR)
+    // nodes come from the list's memory resource, and go back to it
+    struct NodeDeleter
+    {
+        std::pmr::memory_resource *resource;
+
+        void operator()(Node *node) const noexcept
+        {
+            node->~Node();
+            resource->deallocate(node, sizeof(Node), alignof(Node));
+        }
+    };
+#else
+    using NodeDeleter = std::default_delete<Node>;
+#endif
+    using NodePtr = std::unique_ptr<Node, NodeDeleter>;
+
     struct Node
     {
         int data;
-        std::unique_ptr<Node> next;
+        NodePtr next;
     };
 
-    std::unique_ptr<Node> head;
+#if defined(ITEM18_PMR)
+    explicit List(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : head(nullptr, NodeDeleter{resource})
+    {
+    }
+#endif
+
+    NodePtr head;
 
     ~List()
     {
@@ -102,14 +230,134 @@ struct List
 
     void push(int data)
     {
-        head = std::unique_ptr<Node>(new Node{data, std::move(head)});
+#if defined(ITEM18_PMR)
+        NodeDeleter deleter = head.get_deleter();
+        void *node = deleter.resource->allocate(sizeof(Node), alignof(Node));
+        head = NodePtr(new (node) Node{data, std::move(head)}, deleter);
+#else
+        head = NodePtr(new Node{data, std::move(head)});
+#endif
     }
 };
 
-int main()
+// Scans the same file four ways and counts its lines. fgetc pays a libc
+// call per byte; fread and ifstream copy into a buffer; the mapping is read
+// in place.
+void benchmarkFileReads(const char *path, std::size_t bytes)
+{
+    auto report = [bytes](const char *name, double ns, std::size_t lines)
+    {
+        std::cout << "  " << name << ": " << bytes / ns << " GB/s (" << lines << " lines)\n";
+    };
+
+    {
+        TRACE_SCOPE("fgetc");
+        std::size_t lines = 0;
+        auto ns = measureNs([&]
+                            {
+            std::unique_ptr<std::FILE, decltype(&close_file)> fp(std::fopen(path, "r"), &close_file);
+            for (int c; (c = std::fgetc(fp.get())) != EOF;)
+                lines += (c == '\n'); });
+        report("fgetc", ns, lines);
+    }
+    {
+        TRACE_SCOPE("fread");
+        std::size_t lines = 0;
+        auto ns = measureNs([&]
+                            {
+            std::unique_ptr<std::FILE, decltype(&close_file)> fp(std::fopen(path, "r"), &close_file);
+            std::vector<char> buffer(1 << 16);
+            for (std::size_t n; (n = std::fread(buffer.data(), 1, buffer.size(), fp.get())) != 0;)
+                lines += std::count(buffer.data(), buffer.data() + n, '\n'); });
+        report("fread", ns, lines);
+    }
+    {
+        TRACE_SCOPE("ifstream + getline");
+        std::size_t lines = 0;
+        auto ns = measureNs([&]
+                            {
+            std::ifstream in(path);
+            for (std::string line; std::getline(in, line);)
+                ++lines; });
+        report("ifstream + getline", ns, lines);
+    }
+    {
+        TRACE_SCOPE("MappedFile + RecordRange");
+        std::size_t lines = 0;
+        auto ns = measureNs([&]
+                            {
+            MappedFile file(path, MappedFile::Access::Sequential);
+            for (const auto &record : RecordRange(file.bytes()))
+            {
+                doNotOptimize(record);
+                ++lines;
+            } });
+        report("MappedFile + RecordRange", ns, lines);
+    }
+}
+
+// Reads `files` small files, each in one go: blocking pread one after the
+// other, then through AsyncFileReader with each of its backends.
+void benchmarkSmallFileReads(std::size_t files, std::size_t fileSize)
+{
+    std::vector<int> fds;
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i != files; ++i)
+    {
+        names.push_back("small_file_" + std::to_string(i) + ".bin");
+        std::ofstream(names.back(), std::ios::binary) << std::string(fileSize, char('a' + i % 26));
+        fds.push_back(::open(names.back().c_str(), O_RDONLY | O_CLOEXEC));
+    }
+    std::vector<char> buffers(files * fileSize);
+
+    auto report = [&](const char *name, double ns, std::size_t bytes)
+    {
+        std::cout << "  " << name << ": " << files / ns * 1e3 << "M files/s, "
+                  << bytes / ns << " GB/s\n";
+    };
+
+    {
+        std::size_t bytes = 0;
+        auto ns = measureNs([&]
+                            {
+            for (std::size_t i = 0; i != files; ++i)
+                bytes += ::pread(fds[i], &buffers[i * fileSize], fileSize, 0); });
+        report("blocking pread", ns, bytes);
+    }
+
+    auto readAll = [&](AsyncFileReader &reader, const char *name)
+    {
+        std::size_t bytes = 0;
+        auto ns = measureNs([&]
+                            {
+            for (std::size_t i = 0; i != files; ++i)
+                reader.read(fds[i], &buffers[i * fileSize], fileSize, 0,
+                            [&bytes](long n)
+                            { bytes += n > 0 ? n : 0; });
+            reader.wait(); });
+        report(name, ns, bytes);
+    };
+    {
+        AsyncFileReader reader(256);
+        readAll(reader, reader.usingIoUring() ? "AsyncFileReader, io_uring"
+                                              : "AsyncFileReader, io_uring unavailable, threads");
+    }
+    {
+        AsyncFileReader reader(256, AsyncFileReader::Backend::Threads);
+        readAll(reader, "AsyncFileReader, threads + pread");
+    }
+
+    for (std::size_t i = 0; i != files; ++i)
+    {
+        ::close(fds[i]);
+        std::remove(names[i].c_str());
+    }
+}
+
+int main(int argc, char *argv[])
 {
     {
-        // auto pInvestment = makeInvestment(argumets);
+        auto pInvestment = makeInvestment(InvestmentKind::Stock, 1000.0);
     } // destroy *pInvestment
 
     {
@@ -131,6 +379,7 @@ int main()
 
     std::cout << "1) Unique ownership semantics demo\n";
     {
+        TRACE_SCOPE("1) Unique ownership semantics");
         // Create a (uniquely owned) resource
         std::unique_ptr<D> p = std::make_unique<D>();
 
@@ -145,6 +394,7 @@ int main()
     std::cout << "\n"
                  "2) Runtime polymorphism demo\n";
     {
+        TRACE_SCOPE("2) Runtime polymorphism");
         // Create a derived resource and point to it via base type
         std::unique_ptr<B> p = std::make_unique<D>();
 
@@ -156,6 +406,7 @@ int main()
                  "3) Custom deleter demo\n";
     std::ofstream("demo.txt") << 'x'; // prepare the file to read
     {
+        TRACE_SCOPE("3) Custom deleter");
         using unique_file_t = std::unique_ptr<std::FILE, decltype(&close_file)>;
         unique_file_t fp(std::fopen("demo.txt", "r"), &close_file);
         if (fp)
@@ -166,6 +417,7 @@ int main()
                  "4) Custom lambda expression deleter and exception safety demo\n";
     try
     {
+        TRACE_SCOPE("4) Custom lambda expression deleter and exception safety");
         std::unique_ptr<D, void (*)(D *)> p(new D, [](D *ptr)
                                             {
             std::cout << "destroying from a custom deleter...\n";
@@ -181,21 +433,149 @@ int main()
     std::cout << "\n"
                  "5) Array form of unique_ptr demo\n";
     {
+        TRACE_SCOPE("5) Array form of unique_ptr");
         std::unique_ptr<D[]> p(new D[3]);
     } // “D::~D()” is called 3 times
 
     std::cout << "\n"
                  "6) Linked list demo\n";
     {
+        TRACE_SCOPE("6) Linked list");
         List wall;
         const int enough{1'000'000};
         for (int beer = 0; beer != enough; ++beer)
             wall.push(beer);
 
-        std::cout.imbue(std::locale("en_US.UTF-8"));
+        try
+        {
+            std::cout.imbue(std::locale("en_US.UTF-8"));
+        }
+        catch (const std::runtime_error &) // locale not installed
+        {
+        }
         std::cout << enough << " bottles of beer on the wall...\n";
     } // destroys all the beers
 
+#if defined(ITEM18_PMR)
+    {
+        // the same wall with every node from one monotonic buffer: a push
+        // bumps a pointer, and popping a node frees nothing, the buffer
+        // goes back in one piece at the end
+        const int enough{1'000'000};
+        double heapNs = measureNs([&]
+                                  {
+            List wall(std::pmr::new_delete_resource());
+            for (int beer = 0; beer != enough; ++beer)
+                wall.push(beer); });
+        double monotonicNs = measureNs([&]
+                                       {
+            std::pmr::monotonic_buffer_resource buffer;
+            List wall(&buffer);
+            for (int beer = 0; beer != enough; ++beer)
+                wall.push(beer); });
+        std::cout << "build and tear down the wall (ns per bottle): new/delete " << heapNs / enough
+                  << ", monotonic_buffer_resource " << monotonicNs / enough << '\n';
+    }
+#endif
+
+    std::cout << "\n"
+                 "7) Type-segregated portfolio demo\n";
+    {
+        TRACE_SCOPE("7) Type-segregated portfolio");
+        const std::size_t count{1'000'000};
+        std::mt19937 gen(18);
+        std::uniform_int_distribution<int> pickKind(0, 2);
+        std::uniform_real_distribution<double> pickAmount(1'000, 100'000);
+
+        double amount{};
+        std::vector<decltype(makeInvestment(InvestmentKind::Stock, amount))> pointers;
+        Portfolio portfolio;
+        for (std::size_t i = 0; i != count; ++i)
+        {
+            auto kind = static_cast<InvestmentKind>(pickKind(gen));
+            amount = pickAmount(gen);
+            pointers.push_back(makeInvestment(kind, amount));
+            addInvestment(portfolio, kind, amount);
+        }
+        // a long-lived portfolio's pointers don't stay in allocation order
+        // (the lambda deleter can't be assigned, so permute by moving)
+        {
+            std::vector<std::size_t> order(count);
+            for (std::size_t i = 0; i != count; ++i)
+                order[i] = i;
+            std::shuffle(order.begin(), order.end(), gen);
+
+            decltype(pointers) shuffled;
+            shuffled.reserve(count);
+            for (auto i : order)
+                shuffled.push_back(std::move(pointers[i]));
+            pointers = std::move(shuffled);
+        }
+
+        double total1 = 0, total2 = 0;
+        auto virtualNs = measureNs([&]
+                                   {
+            for (const auto &p : pointers)
+                total1 += p->value(); });
+        auto segmentedNs = measureNs([&]
+                                     { portfolio.forEach([&](const auto &inv)
+                                                         { total2 += inv.value(); }); });
+
+        std::cout << "unique_ptr<Investment>: " << virtualNs / count << " ns, "
+                  << "segmented: " << segmentedNs / count << " ns per value(), "
+                  << "same total: " << (std::abs(total1 - total2) < 1e-9 * total1) << '\n';
+
+        logEntries = 0;
+        pointers.clear();
+        portfolio.clear();
+        std::cout << logEntries << " log entries for " << 2 * count << " Investments\n";
+    }
+
+    std::cout << "\n"
+                 "8) Memory-mapped file demo\n";
+    {
+        TRACE_SCOPE("8) Memory-mapped file");
+        MappedFile file("demo.txt");  // unmapped and closed in the dtor,
+        if (!file.bytes().empty())    // like unique_file_t above
+            std::cout << char(file.bytes()[0]) << '\n';
+
+        // usage: item18 [MiB], for multi-GB runs
+        const std::size_t mib = argc > 1 ? std::stoul(argv[1]) : 64;
+        {
+            std::ofstream out("records.txt", std::ios::binary);
+            std::string line;
+            for (std::size_t written = 0, i = 0; written < mib << 20; written += line.size(), ++i)
+            {
+                line = "record " + std::to_string(i) + ',' + std::string(i % 61, 'v') + '\n';
+                out << line;
+            }
+        }
+        std::cout << "scanning " << mib << " MiB (page cache warm):\n";
+        benchmarkFileReads("records.txt", mib << 20);
+        std::remove("records.txt");
+    }
+
+    std::cout << "\n"
+                 "9) Batched asynchronous reads demo\n";
+    {
+        TRACE_SCOPE("9) Batched asynchronous reads");
+        AsyncFileReader reader;
+        int fd = ::open("demo.txt", O_RDONLY | O_CLOEXEC);
+        char c = 0;
+        reader.read(fd, &c, 1, 0, [&c](long n) // runs inside wait()
+                    { std::cout << n << " byte read: " << c << '\n'; });
+        reader.wait();
+        ::close(fd);
+
+        std::cout << "reading 4096 files of 4 KiB (page cache warm):\n";
+        benchmarkSmallFileReads(4096, 4096);
+    }
+
+    // TRACE_JSON=item18.trace.json item18 exports the spans
+    if (const char *path = std::getenv("TRACE_JSON"))
+        if (trace::writeJson(path))
+            std::cout << "\nwrote " << path << '\n';
+
     return 0;
 }
 
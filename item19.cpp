@@ -4,6 +4,15 @@
 #include <memory>
 #include <vector>
 
+#include "bench.h"
+#include "pool_allocator.h"
+
+// cmake -DCXX17_PMR=ON
+#if __cplusplus >= 201703L
+#include "memory_resources.h"
+#define ITEM19_PMR 1
+#endif
+
 // • std::shared_ptrs are twice the size of a raw pointer, because they internally
 // contain a raw pointer to the resource as well as a raw pointer to the resource’s
 // reference count.
@@ -67,7 +76,11 @@ public:
 
 class Widget;
 
+#if defined(ITEM19_PMR)
+std::pmr::vector<std::shared_ptr<Widget>> processedWidgets; // on the default resource
+#else
 std::vector<std::shared_ptr<Widget>> processedWidgets;
+#endif
 
 class Widget : public std::enable_shared_from_this<Widget>
 {
@@ -150,6 +163,48 @@ int main()
     vv->push_back(10);
     std ::cout << vv->at(0) << '\n';
 
+    // Allocation cost alone (A's constructor logs, so nothing is constructed):
+    // the global heap versus the thread-caching pool from pool_allocator.h.
+    auto allocFreeNs = [](auto alloc, unsigned threads)
+    {
+        using Traits = std::allocator_traits<decltype(alloc)>;
+        constexpr int rounds = 2000;
+        constexpr int batch = 64;
+
+        double ns = runOnThreads(threads, [&](unsigned)
+                                 {
+            auto a = alloc;
+            A *ptrs[batch];
+            for (int r = 0; r != rounds; ++r)
+            {
+                for (auto &p : ptrs)
+                    p = Traits::allocate(a, 1);
+                doNotOptimize(ptrs);
+                for (auto &p : ptrs)
+                    Traits::deallocate(a, p, 1);
+            } });
+        return ns / (double(threads) * rounds * batch);
+    };
+
+#if defined(ITEM19_PMR)
+    // the same pool behind a std::pmr::memory_resource costs a virtual call
+    // per allocation, and lets any pmr container use it
+    PoolResource poolResource;
+    std ::cout << "A (ns per allocate/deallocate, malloc vs pool vs PoolResource)\n";
+#else
+    std ::cout << "A (ns per allocate/deallocate, malloc vs pool)\n";
+#endif
+    for (unsigned threads = 1; threads <= 64; threads *= 2)
+    {
+        std ::cout << "  " << threads << " threads: "
+                   << allocFreeNs(std::allocator<A>(), threads) << " vs "
+                   << allocFreeNs(pool::PoolAllocator<A>(), threads);
+#if defined(ITEM19_PMR)
+        std ::cout << " vs " << allocFreeNs(std::pmr::polymorphic_allocator<A>(&poolResource), threads);
+#endif
+        std ::cout << '\n';
+    }
+
     return 0;
 }
 
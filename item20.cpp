@@ -4,6 +4,31 @@
 #include <memory>
 #include <unordered_map>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench.h"
+#include "bloom_filter.h"
+#include "cache_snapshot.h"
+#include "flat_hash_map.h"
+#include "pinning_cache.h"
+#include "slot_map.h"
+
+// cmake -DCXX17_PMR=ON
+#if __cplusplus >= 201703L
+#include "memory_resources.h"
+#define ITEM20_PMR 1
+#endif
 
 using WidgetID = uint32_t;
 
@@ -13,9 +38,45 @@ using WidgetID = uint32_t;
 
 class Widget
 {
+public:
+    explicit Widget(WidgetID id = 0) : id(id) {}
+
+    WidgetID id;
+    std::vector<uint32_t> payload;
 };
 
-std::shared_ptr<const Widget> fastLoadWidget(WidgetID id)
+const WidgetID kStoredWidgets = 1000000; // the store has Widgets 0..999999
+
+// stands in for reading a Widget from a file or database: about a
+// microsecond of work and a 1 KiB allocation, whether it's found or not
+std::shared_ptr<const Widget> loadWidget(WidgetID id)
+{
+    auto w = std::make_shared<Widget>(id);
+    w->payload.resize(256);
+    uint32_t x = id * 2654435761u + 1;
+    for (auto &word : w->payload)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        word = x;
+    }
+    if (id >= kStoredWidgets)
+        return nullptr;
+    return w;
+}
+
+// A filter of the IDs the store has. Build a new one when Widgets are
+// removed from the store, or more are added than it was sized for.
+BlockedBloomFilter storedWidgetFilter(double fpr)
+{
+    BlockedBloomFilter filter(kStoredWidgets, fpr);
+    for (WidgetID id = 0; id != kStoredWidgets; ++id)
+        filter.insert(id);
+    return filter;
+}
+
+std::shared_ptr<const Widget> weakLoadWidget(WidgetID id)
 {
     static std::unordered_map<WidgetID,
                               std::weak_ptr<const Widget>>
@@ -24,13 +85,217 @@ std::shared_ptr<const Widget> fastLoadWidget(WidgetID id)
     // to cached object (or null
     // if object's not in cache)
     if (!objPtr)
-    { // if not in cache,
-      // objPtr = loadWidget(id); // load it
-      // cache[id] = objPtr;      // cache it
+    {                            // if not in cache,
+        objPtr = loadWidget(id); // load it
+        cache[id] = objPtr;      // cache it
     }
     return objPtr;
 }
 
+// A weak_ptr cache forgets a Widget the moment its last user lets go, and a
+// hot Widget that's used briefly but often is reloaded on nearly every call.
+// This one also pins the most recently used Widgets (see pinning_cache.h).
+// Requests for Widgets that don't exist are mostly turned away by a Bloom
+// filter, before they reach the cache or the store.
+std::shared_ptr<const Widget> fastLoadWidget(WidgetID id)
+{
+    static const BlockedBloomFilter stored = storedWidgetFilter(0.01);
+    if (!stored.mayContain(id))
+        return nullptr;
+#if defined(ITEM20_PMR)
+    // the cache outlives every request and serves every thread: its map
+    // comes from the thread-caching pool
+    static PoolResource pool;
+    static PinningCache<WidgetID, Widget> cache(loadWidget, 4096, 4, &pool);
+#else
+    static PinningCache<WidgetID, Widget> cache(loadWidget, 4096);
+#endif
+    return cache.get(id);
+}
+
+// length requests for ids 0..ids-1, the k-th most popular asked for with
+// probability proportional to 1/k^s; popularity is shuffled over the ids
+std::vector<WidgetID> zipfTrace(WidgetID ids, size_t length, double s, unsigned seed)
+{
+    std::vector<double> cdf(ids);
+    double sum = 0;
+    for (WidgetID k = 0; k != ids; ++k)
+        cdf[k] = sum += 1 / std::pow(k + 1.0, s);
+
+    std::mt19937_64 rng(seed);
+    std::vector<WidgetID> byPopularity(ids);
+    std::iota(byPopularity.begin(), byPopularity.end(), 0);
+    std::shuffle(byPopularity.begin(), byPopularity.end(), rng);
+
+    std::uniform_real_distribution<double> u(0, sum);
+    std::vector<WidgetID> trace(length);
+    for (auto &id : trace)
+    {
+        size_t k = std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        id = byPopularity[std::min<size_t>(k, ids - 1)];
+    }
+    return trace;
+}
+
+// every request holds its Widget only while using it, the case where a
+// weak_ptr cache alone keeps almost nothing; every 16th is timed
+void runTrace(const std::vector<WidgetID> &trace, size_t pinned, unsigned threads)
+{
+    PinningCache<WidgetID, Widget> cache(loadWidget, pinned);
+    std::vector<std::vector<double>> samples(threads);
+
+    double ns = runOnThreads(threads, [&](unsigned t)
+                             {
+        size_t first = trace.size() * t / threads, last = trace.size() * (t + 1) / threads;
+        for (size_t i = first; i != last; ++i)
+        {
+            if (i % 16 != 0)
+            {
+                auto w = cache.get(trace[i]);
+                doNotOptimize(w->payload[0]);
+                continue;
+            }
+            samples[t].push_back(measureNs([&]
+                                           {
+                auto w = cache.get(trace[i]);
+                doNotOptimize(w->payload[0]); }));
+        } });
+
+    std::vector<double> all;
+    for (auto &s : samples)
+        all.insert(all.end(), s.begin(), s.end());
+    std::sort(all.begin(), all.end());
+
+    PinningCacheStats stats = cache.stats();
+    std::cout << "  pinned " << pinned << ": hit rate " << 100.0 * stats.hits / trace.size()
+              << "% (" << 100.0 * stats.pinnedHits / trace.size() << "% pinned), "
+              << ns / trace.size() << " ns per get, p50 " << all[all.size() / 2]
+              << " ns, p99 " << all[all.size() * 99 / 100] << " ns\n";
+}
+
+void benchmarkPinning(size_t requests, size_t pinned)
+{
+    const WidgetID ids = 1000000;
+    const unsigned threads = 4;
+    auto trace = zipfTrace(ids, requests, 0.99, 20);
+
+    std::cout << requests << " zipf(0.99) requests over " << ids << " Widgets on " << threads
+              << " threads:\n";
+    runTrace(trace, 0, threads);
+    runTrace(trace, pinned, threads);
+}
+
+void saveWidget(CacheSnapshotWriter &out, const Widget &w)
+{
+    out.add(w.id, w.payload.data(), w.payload.size() * sizeof(uint32_t));
+}
+
+std::shared_ptr<const Widget> restoreWidget(WidgetID id, ByteSpan bytes)
+{
+    auto w = std::make_shared<Widget>(id);
+    w->payload.resize(bytes.size() / sizeof(uint32_t));
+    std::memcpy(w->payload.data(), bytes.data(), w->payload.size() * sizeof(uint32_t));
+    return w;
+}
+
+// Replays trace from process start, cold or from the snapshot at path. A
+// request is a hit if it didn't call loadWidget, whether its Widget was
+// cached or rehydrated from the snapshot. Steady state is reached with the
+// first 1000 requests whose hit rate is within 1% of steadyHitRate, or, if
+// that's 0, of the hit rate over the last quarter of the trace, which is
+// returned.
+double startUp(const std::vector<WidgetID> &trace, size_t pinned, const char *path,
+               double steadyHitRate = 0)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto usSince = [&]
+    { return std::chrono::duration<double, std::micro>(Clock::now() - start).count(); };
+
+    CacheSnapshot snapshot = path ? CacheSnapshot(path) : CacheSnapshot();
+    size_t loads = 0;
+    PinningCache<WidgetID, Widget> cache([&](WidgetID id)
+                                         {
+        ByteSpan bytes = snapshot.find(id);
+        if (!bytes.empty())
+            return restoreWidget(id, bytes);
+        ++loads;
+        return loadWidget(id); },
+                                         pinned);
+    double opened = usSince();
+
+    const size_t window = 1000;
+    double firstHit = 0;
+    std::vector<double> windowEnds;
+    std::vector<size_t> windowLoads;
+    for (size_t i = 0; i != trace.size(); ++i)
+    {
+        size_t before = loads;
+        auto w = cache.get(trace[i]);
+        doNotOptimize(w->payload[0]);
+        if (firstHit == 0 && loads == before)
+            firstHit = usSince();
+        if ((i + 1) % window == 0)
+        {
+            windowEnds.push_back(usSince());
+            windowLoads.push_back(loads);
+        }
+    }
+    if (windowEnds.size() < 4)
+        return 0;
+
+    size_t lastQuarter = windowEnds.size() * 3 / 4;
+    if (steadyHitRate == 0)
+        steadyHitRate = 1 - double(windowLoads.back() - windowLoads[lastQuarter - 1]) /
+                                ((windowEnds.size() - lastQuarter) * window);
+    double steady = 0;
+    for (size_t i = 0; i != windowEnds.size() && steady == 0; ++i)
+    {
+        size_t windowMisses = windowLoads[i] - (i ? windowLoads[i - 1] : 0);
+        if (1 - double(windowMisses) / window >= steadyHitRate - 0.01)
+            steady = windowEnds[i];
+    }
+
+    std::cout << (path ? "  warm start: " : "  cold start: ") << "ready after " << opened
+              << " us (" << snapshot.size() << " Widgets in snapshot), first hit after " << firstHit
+              << " us, steady state (" << 100 * steadyHitRate << "% hits) after " << steady / 1000
+              << " ms, " << loads << " loads\n";
+    return steadyHitRate;
+}
+
+void benchmarkWarmStart(size_t requests, size_t pinned)
+{
+    const WidgetID ids = 1000000;
+    // in the temporary directory, and gone after the run
+    const char *tmp = std::getenv("TMPDIR");
+    const std::string file = std::string(tmp && *tmp ? tmp : "/tmp") + "/item20." +
+                             std::to_string(::getpid()) + ".snapshot";
+    const char *path = file.c_str();
+
+    // the previous run: warm up, then save what's pinned at exit
+    {
+        PinningCache<WidgetID, Widget> cache(loadWidget, pinned);
+        for (WidgetID id : zipfTrace(ids, requests, 0.99, 20))
+            cache.get(id);
+
+        CacheSnapshotWriter out;
+        double ns = measureNs([&]
+                              {
+            cache.forEachPinned([&](WidgetID, const std::shared_ptr<const Widget> &w)
+                                { saveWidget(out, *w); });
+            out.write(path); });
+        std::cout << "snapshot of " << out.size() << " pinned Widgets written in " << ns / 1e6
+                  << " ms\n";
+    }
+
+    // this run asks for the same Widgets, in a different order
+    auto trace = zipfTrace(ids, requests, 0.99, 20);
+    std::shuffle(trace.begin(), trace.end(), std::mt19937_64(21));
+    double steadyHitRate = startUp(trace, pinned, nullptr);
+    startUp(trace, pinned, path, steadyHitRate);
+    std::remove(path);
+}
+
 struct B;
 
 struct A
@@ -65,7 +330,204 @@ struct B
 // count in the control block, and it’s this second reference count that std::weak_ptrs
 // manipulate. For details, continue on to Item 21.
 
-int main()
+// ns per operation on n cache entries: insert all, find all in random
+// order, erase half, find the erased half, and iterate over the rest
+struct EntryTimes
+{
+    double insert, find, erase, findErased, iterate;
+};
+
+using CacheEntry = std::weak_ptr<const Widget>;
+
+EntryTimes timeUnorderedMap(const std::vector<WidgetID> &order)
+{
+    size_t n = order.size(), found = 0;
+    std::unordered_map<WidgetID, CacheEntry> entries;
+    EntryTimes t;
+    t.insert = measureNs([&]
+                         {
+        entries.reserve(n);
+        for (WidgetID id = 0; id != n; ++id)
+            entries.emplace(id, CacheEntry()); }) / n;
+    t.find = measureNs([&]
+                       {
+        for (WidgetID id : order)
+            found += entries.find(id)->second.use_count(); }) / n;
+    t.erase = measureNs([&]
+                        {
+        for (size_t i = 0; i != n / 2; ++i)
+            entries.erase(order[i]); }) / (n / 2);
+    t.findErased = measureNs([&]
+                             {
+        for (size_t i = 0; i != n / 2; ++i)
+            found += entries.find(order[i]) != entries.end(); }) / (n / 2);
+    t.iterate = measureNs([&]
+                          {
+        for (const auto &e : entries)
+            found += e.second.use_count(); }) / (n - n / 2);
+    doNotOptimize(found);
+    return t;
+}
+
+// the SlotMap issues the keys, which stand in for WidgetIDs; like the IDs
+// above, they're read in order from a vector of their own
+EntryTimes timeSlotMap(const std::vector<WidgetID> &order)
+{
+    size_t n = order.size(), found = 0;
+    SlotMap<CacheEntry> entries;
+    std::vector<SlotKey> keys(n);
+    EntryTimes t;
+    t.insert = measureNs([&]
+                         {
+        entries.reserve(n);
+        for (WidgetID id = 0; id != n; ++id)
+            keys[id] = entries.insert(CacheEntry()); }) / n;
+
+    std::vector<SlotKey> ordered(n);
+    for (size_t i = 0; i != n; ++i)
+        ordered[i] = keys[order[i]];
+    t.find = measureNs([&]
+                       {
+        for (SlotKey key : ordered)
+            found += entries.find(key)->use_count(); }) / n;
+    t.erase = measureNs([&]
+                        {
+        for (size_t i = 0; i != n / 2; ++i)
+            entries.erase(ordered[i]); }) / (n / 2);
+    t.findErased = measureNs([&]
+                             {
+        for (size_t i = 0; i != n / 2; ++i)
+            found += entries.find(ordered[i]) != nullptr; }) / (n / 2);
+    t.iterate = measureNs([&]
+                          {
+        for (const auto &e : entries)
+            found += e.use_count(); }) / (n - n / 2);
+    doNotOptimize(found);
+    return t;
+}
+
+void benchmarkSlotMap(size_t largest)
+{
+    for (size_t n = 1000000; n <= largest; n *= 10)
+    {
+        std::vector<WidgetID> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(n));
+
+        EntryTimes map = timeUnorderedMap(order), slots = timeSlotMap(order);
+        std::cout << n << " cache entries (ns per op, unordered_map vs SlotMap): insert " << map.insert
+                  << " vs " << slots.insert << ", find " << map.find << " vs " << slots.find
+                  << ", erase " << map.erase << " vs " << slots.erase << ", find erased "
+                  << map.findErased << " vs " << slots.findErased << ", iterate " << map.iterate
+                  << " vs " << slots.iterate << '\n';
+    }
+}
+
+// lookups of IDs the store doesn't have, through the cache and store, and
+// turned away by a filter of the IDs it does have
+void benchmarkNegativeLookups(size_t lookups)
+{
+    std::mt19937_64 rng(48);
+    std::uniform_int_distribution<WidgetID> missing(kStoredWidgets, ~WidgetID(0)), stored(0, kStoredWidgets - 1);
+    std::vector<WidgetID> absent(lookups), present(lookups);
+    for (size_t i = 0; i != lookups; ++i)
+    {
+        absent[i] = missing(rng);
+        present[i] = stored(rng);
+    }
+
+    PinningCache<WidgetID, Widget> cache(loadWidget, 4096);
+    double unfiltered = measureNs([&]
+                                  {
+        for (WidgetID id : absent)
+            doNotOptimize(cache.get(id)); }) / lookups;
+    std::cout << lookups << " lookups of missing Widgets: " << unfiltered
+              << " ns each through the cache and store\n";
+
+    for (double fpr : {0.01, 0.001})
+    {
+        auto start = std::chrono::steady_clock::now();
+        BlockedBloomFilter filter = storedWidgetFilter(fpr);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        size_t passed = 0;
+        double negative = measureNs([&]
+                                    {
+            for (WidgetID id : absent)
+                passed += filter.mayContain(id); }) / lookups;
+        double positive = measureNs([&]
+                                    {
+            for (WidgetID id : present)
+                passed += filter.mayContain(id); }) / lookups;
+        passed -= lookups;
+
+        std::cout << "  filter at " << fpr * 100 << "% false positives: "
+                  << filter.bytes() * 1e6 / kStoredWidgets / (1 << 20) << " MiB per million IDs, built in "
+                  << buildMs << " ms; " << 100.0 * passed / lookups << "% of missing IDs get through, "
+                  << negative << " ns per negative lookup, " << positive << " ns added to a hit\n";
+    }
+}
+
+// ns per operation on a table of `slots` buckets filled to load factor lf
+// with scattered WidgetIDs: insert them all, find each of them and as many
+// that aren't there, in random order, then erase them all
+struct TableTimes
+{
+    double insert, findHit, findMiss, erase;
+};
+
+template <typename Map>
+TableTimes timeTable(size_t slots, double lf)
+{
+    size_t n = static_cast<size_t>(slots * lf), found = 0;
+    std::vector<WidgetID> ids(n), missing(n);
+    for (size_t i = 0; i != n; ++i)
+    {
+        ids[i] = static_cast<WidgetID>(i * 2654435761u); // distinct: the multiplier is odd
+        missing[i] = static_cast<WidgetID>((i + n) * 2654435761u);
+    }
+    std::vector<WidgetID> order(ids);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(slots));
+
+    Map entries;
+    entries.rehash(slots);
+    TableTimes t;
+    t.insert = measureNs([&]
+                         {
+        for (WidgetID id : ids)
+            entries[id]; }) / n;
+    t.findHit = measureNs([&]
+                          {
+        for (WidgetID id : order)
+            found += entries.find(id) != entries.end(); }) / n;
+    t.findMiss = measureNs([&]
+                           {
+        for (WidgetID id : missing)
+            found += entries.find(id) != entries.end(); }) / n;
+    t.erase = measureNs([&]
+                        {
+        for (WidgetID id : order)
+            entries.erase(id); }) / n;
+    doNotOptimize(found);
+    return t;
+}
+
+void benchmarkFlatHashMap()
+{
+    const size_t slots = 1 << 21;
+    for (double lf : {0.25, 0.5, 0.75, 0.875})
+    {
+        TableTimes map = timeTable<std::unordered_map<WidgetID, CacheEntry>>(slots, lf),
+                   flat = timeTable<FlatHashMap<WidgetID, CacheEntry>>(slots, lf);
+        std::cout << slots << " buckets at load factor " << lf
+                  << " (ns per op, unordered_map vs FlatHashMap): insert " << map.insert << " vs "
+                  << flat.insert << ", find hit " << map.findHit << " vs " << flat.findHit << ", find miss "
+                  << map.findMiss << " vs " << flat.findMiss << ", erase " << map.erase << " vs "
+                  << flat.erase << '\n';
+    }
+}
+
+int main(int argc, char *argv[])
 {
     auto spw =                      // after spw is constructed,
         std::make_shared<Widget>(); // the pointed-to Widget's
@@ -120,6 +582,24 @@ int main()
 
     std ::cout << aptr.use_count() << ' ' << bptr.use_count() << '\n';
 
+    auto w = fastLoadWidget(7);
+    std ::cout << (weakLoadWidget(7)->payload == w->payload) << '\n';
+
+    // argv[1] requests (default 2 million), argv[2] Widgets pinned (default
+    // 10000), argv[3] most cache entries (default 1 million; 10 million
+    // needs about 800 MiB, 100 million about 8 GiB)
+    size_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    size_t pinned = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000;
+    size_t entries = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1000000;
+    if (requests > 0)
+    {
+        benchmarkPinning(requests, pinned);
+        benchmarkWarmStart(requests, pinned);
+        benchmarkNegativeLookups(requests / 4);
+    }
+    benchmarkSlotMap(entries);
+    benchmarkFlatHashMap();
+
     return 0;
 }
 
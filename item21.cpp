@@ -1,7 +1,12 @@
 // Item 21: Prefer std::make_unique and std::make_shared to direct use of new.
 
+#include <array>
 #include <iostream>
 #include <memory>
+#include <thread>
+
+#include "bench.h"
+#include "pool_allocator.h"
 
 // Let’s begin by leveling the playing field for std::make_unique and std::
 // make_shared. std::make_shared is part of C++11, but, sadly, std::make_
@@ -29,6 +34,54 @@ class ReallyBigType
 {
 };
 
+// std::allocate_shared is the make function for objects whose memory should come
+// from somewhere other than the global heap. pool_allocator.h provides a
+// thread-caching pool allocator for that and the matching allocate_unique.
+//
+// Every thread repeatedly creates a batch of objects through make() and then
+// drops them; the result is wall-clock ns per create/destroy pair over all threads.
+template <typename Make>
+double createDestroyNs(unsigned threads, Make make)
+{
+    constexpr int rounds = 2000;
+    constexpr int batch = 64;
+
+    double ns = runOnThreads(threads, [&](unsigned)
+                             {
+        std::array<decltype(make()), batch> ptrs;
+        for (int r = 0; r != rounds; ++r)
+        {
+            for (auto &p : ptrs)
+                p = make();
+            doNotOptimize(ptrs);
+            for (auto &p : ptrs)
+                p.reset();
+        } });
+    return ns / (double(threads) * rounds * batch);
+}
+
+template <typename T>
+void benchmarkPool(const char *name)
+{
+    pool::PoolAllocator<T> alloc;
+
+    std::cout << name << " (ns per create/destroy, malloc vs pool)\n";
+    for (unsigned threads = 1; threads <= 64; threads *= 2)
+    {
+        auto uniqueMalloc = createDestroyNs(threads, []
+                                            { return std::make_unique<T>(); });
+        auto uniquePool = createDestroyNs(threads, [&]
+                                          { return pool::allocate_unique<T>(alloc); });
+        auto sharedMalloc = createDestroyNs(threads, []
+                                            { return std::make_shared<T>(); });
+        auto sharedPool = createDestroyNs(threads, [&]
+                                          { return std::allocate_shared<T>(alloc); });
+
+        std::cout << "  " << threads << " threads: unique " << uniqueMalloc << " vs "
+                  << uniquePool << ", shared " << sharedMalloc << " vs " << sharedPool << '\n';
+    }
+}
+
 int main()
 {
     auto upw1(std::make_unique<Widget>());    // with make func
@@ -72,6 +125,23 @@ int main()
         // memory for control block is released
     }
 
+    {
+        pool::PoolAllocator<Widget> alloc;
+
+        auto spw3(std::allocate_shared<Widget>(alloc)); // object and control
+                                                        // block from the pool
+        auto upw3(pool::allocate_unique<Widget>(alloc)); // stateless allocator,
+                                                         // so no size penalty
+        std::cout << sizeof(upw1) << ' ' << sizeof(upw3) << '\n';
+
+        // the last owner may live on another thread; the memory goes back
+        // to the free list of the thread that allocated it
+        std::thread([p = std::move(spw3)] {}).join();
+    }
+
+    benchmarkPool<Widget>("Widget");
+    benchmarkPool<ReallyBigType>("ReallyBigType");
+
     return 0;
 }
 
@@ -1,7 +1,15 @@
 // Item 22: When using the Pimpl Idiom, define special member functions in the implementation file.
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "fast_pimpl.h"
 
 // That’s the technique whereby you replace the
 // data members of a class with a pointer to an implementation class (or struct), put the
@@ -14,6 +22,8 @@ class Widget
 public:
     Widget();
     ~Widget(); // dtor is needed—see below
+    double weight() const;
+
 private:
     struct Impl; // declare implementation struct
     Impl *pImpl; // and pointer to it
@@ -43,6 +53,10 @@ class Widget1
 { // in "widget.h"
 public:
     Widget1();
+    ~Widget1();                               // declaration only
+    Widget1(Widget1 &&rhs) noexcept;            // declarations
+    Widget1 &operator=(Widget1 &&rhs) noexcept; // only
+    double weight() const;
 
 private:
     struct Impl;
@@ -63,8 +77,103 @@ private:
 //     : pImpl(std::make_unique<Impl>()) // std::unique_ptr
 // {} // via std::make_unique
 
+// Both versions pay for a heap allocation per Widget and a pointer chase on every
+// member access. A "fast pImpl" keeps Impl inside the Widget, in raw storage whose
+// size and alignment are the only things the header has to know about Impl.
+class Widget2
+{ // in "widget.h"
+public:
+    Widget2();
+    ~Widget2();
+    Widget2(Widget2 &&rhs) noexcept;
+    Widget2 &operator=(Widget2 &&rhs) noexcept;
+    double weight() const;
+
+private:
+    struct Impl;
+    FastPimpl<Impl, 64, alignof(double)> pImpl; // no pointer, no allocation
+};
+
+// What follows is the implementation file ("widget.cpp") of all three versions.
+// Gadget isn't part of this demo, so Impl holds just a name, the data and a
+// weight to read back.
+
+struct Widget::Impl
+{
+    std::string name;
+    std::vector<double> data;
+    double weight{1.0};
+};
+Widget::Widget() : pImpl(new Impl) {}
+Widget::~Widget() { delete pImpl; }
+double Widget::weight() const { return pImpl->weight; }
+
+struct Widget1::Impl
+{
+    std::string name;
+    std::vector<double> data;
+    double weight{1.0};
+};
+Widget1::Widget1() : pImpl(std::make_unique<Impl>()) {}
+Widget1::~Widget1() = default;
+Widget1::Widget1(Widget1 &&rhs) noexcept = default;
+Widget1 &Widget1::operator=(Widget1 &&rhs) noexcept = default;
+double Widget1::weight() const { return pImpl->weight; }
+
+struct Widget2::Impl
+{
+    std::string name;
+    std::vector<double> data;
+    double weight{1.0};
+};
+Widget2::Widget2() = default;  // Impl is complete here, so this is where
+Widget2::~Widget2() = default; // FastPimpl checks its size and alignment
+Widget2::Widget2(Widget2 &&rhs) noexcept = default;
+Widget2 &Widget2::operator=(Widget2 &&rhs) noexcept = default;
+double Widget2::weight() const { return pImpl->weight; }
+
+// construction, sequential and random member access over a vector of n Widgets
+template <typename W>
+void benchmarkPimpl(const char *name, const std::vector<std::size_t> &order)
+{
+    const std::size_t n = order.size();
+    std::vector<W> widgets;
+    double sum = 0;
+
+    auto construct = measureNs([&]
+                               { widgets = std::vector<W>(n); });
+    auto iterate = measureNs([&]
+                             {
+        for (const auto &w : widgets)
+            sum += w.weight(); });
+    auto access = measureNs([&]
+                            {
+        for (auto i : order)
+            sum += widgets[i].weight(); });
+    auto destroy = measureNs([&]
+                             { widgets = std::vector<W>(); });
+    doNotOptimize(sum);
+
+    std::cout << name << " (" << sizeof(W) << " bytes): construct " << construct / n
+              << ", destroy " << destroy / n << ", iterate " << iterate / n
+              << ", random access " << access / n << " ns per Widget\n";
+}
+
 int main()
 {
+    Widget2 w;
+    Widget2 w1(std::move(w)); // moving copies Impl's members, not a pointer
+    w = std::move(w1);
+    std::cout << w.weight() << '\n';
+
+    std::vector<std::size_t> order(1'000'000);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(22));
+
+    benchmarkPimpl<Widget>("Widget  (raw Impl*)", order);
+    benchmarkPimpl<Widget1>("Widget1 (unique_ptr<Impl>)", order);
+    benchmarkPimpl<Widget2>("Widget2 (FastPimpl<Impl>)", order);
+
     return 0;
 }
 
@@ -74,4 +183,6 @@ int main()
 // • For std::unique_ptr pImpl pointers, declare special member functions in
 // the class header, but implement them in the implementation file. Do this even
 // if the default function implementations are acceptable.
-// • The above advice applies to std::unique_ptr, but not to std::shared_ptr.
\ No newline at end of file
+// • The above advice applies to std::unique_ptr, but not to std::shared_ptr.
+// • A fast pImpl trades a size and alignment written in the header for no
+// allocation and no indirection; the same special member function advice applies.
\ No newline at end of file
@@ -2,6 +2,13 @@
 
 #include <iostream>
 #include <string>
+#include <cstdlib>
+#include <vector>
+
+#define INSTRUMENT_ALLOCATIONS
+#include "bench.h"
+#include "instrumented.h"
+#include "small_vector.h"
 
 // std::move and std::forward are merely functions (actually function templates)
 // that perform casts. std::move unconditionally casts its argument to an rvalue, while
@@ -35,14 +42,26 @@ namespace item23 {
         explicit D() {};
 
         D(const D& d) {
-            std :: cout << "D copy constr\n";
+            ++copies;
+            if (verbose)
+                std :: cout << "D copy constr\n";
         }
 
         D(D &&d) {
-            std :: cout << "D move constr\n";
+            ++moves;
+            if (verbose)
+                std :: cout << "D move constr\n";
         }
+
+        static bool verbose;    // off while benchmarking
+        static std::size_t copies;
+        static std::size_t moves;
     };
 
+    bool D::verbose = true;
+    std::size_t D::copies = 0;
+    std::size_t D::moves = 0;
+
     class Widget {
     public:
         Widget(Widget&& rhs) : s(std::move(rhs.s)) {
@@ -81,7 +100,67 @@ namespace item23 {
 // is a conditional cast: it casts to an rvalue only if its argument was initialized with an
 // rvalue.
 
-int main()
+struct Pod
+{
+    int values[4];
+};
+
+// ns per push_back when filling `containers` containers with k elements each
+template <typename Container, typename Make>
+double fillNs(std::size_t containers, std::size_t k, Make make)
+{
+    double ns = measureNs([&]
+                          {
+        for (std::size_t c = 0; c != containers; ++c)
+        {
+            Container v;
+            for (std::size_t i = 0; i != k; ++i)
+                v.push_back(make(i));
+            doNotOptimize(v.data());
+        } });
+    return ns / (containers * k);
+}
+
+template <typename T, typename Make>
+void benchmarkSmallVector(const char *name, std::size_t elements, Make make)
+{
+    for (std::size_t k : {8, 100})
+        std::cout << "  " << name << ", " << k << " per container: std::vector "
+                  << fillNs<std::vector<T>>(elements / k, k, make) << ", small_vector<16> "
+                  << fillNs<small_vector<T, 16>>(elements / k, k, make) << '\n';
+}
+
+// D's move constructor isn't noexcept, so growing either container copies
+// every D; small_vector just grows less often
+void countDOperations(std::size_t k)
+{
+    using item23::D;
+    auto perElement = [k](auto &&fill)
+    {
+        D::copies = D::moves = 0;
+        fill();
+        return std::to_string(D::copies / double(k)) + " copies and " +
+               std::to_string(D::moves / double(k)) + " moves";
+    };
+
+    std::cout << "  D operations per element (" << k << " elements): std::vector "
+              << perElement([k]
+                            {
+                      INSTRUMENT_SITE("item23: 100 push_backs, std::vector<D>");
+                      std::vector<D> v;
+                      for (std::size_t i = 0; i != k; ++i)
+                          v.push_back(D()); })
+              << ", small_vector<16> "
+              << perElement([k]
+                            {
+                      INSTRUMENT_SITE("item23: 100 push_backs, small_vector<D, 16>");
+                      small_vector<D, 16> v;
+                      for (std::size_t i = 0; i != k; ++i)
+                          v.push_back(D()); })
+              << '\n';
+}
+
+int main(int argc, char *argv[])
 {
     item23::D d1;
     const item23::D d2;
@@ -91,11 +170,35 @@ int main()
     item23::D d5{std :: move(d1)};  // move
     item23::D d6(std :: move(d2));  // copy
 
+    // the same, counted (see the summary at exit): std::move on a const D
+    // still copies
+    {
+        INSTRUMENT_SITE("item23: d6(std::move(d2)), d2 const");
+        const Instrumented<item23::D> c2;
+        Instrumented<item23::D> c6(std :: move(c2));
+    }
+
     int a = 10;
 
     int &&b = 15;
     b = a;
 
+    // push_back into containers that start small (argv[1] elements per
+    // type, default 2 million)
+    std::size_t elements = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    if (elements > 0)
+    {
+        item23::D::verbose = false;
+        std::cout << "ns per push_back\n";
+        benchmarkSmallVector<item23::D>("D", elements, [](std::size_t)
+                                        { return item23::D(); });
+        benchmarkSmallVector<std::string>("std::string", elements, [](std::size_t i)
+                                          { return std::string(12, char('a' + i % 26)); });
+        benchmarkSmallVector<Pod>("Pod", elements, [](std::size_t i)
+                                  { return Pod{{int(i), 1, 2, 3}}; });
+        countDOperations(100);
+    }
+
     return 0;
 }
 
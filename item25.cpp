@@ -3,6 +3,10 @@
 #include <iostream>
 #include <memory>
 
+#define INSTRUMENT_ALLOCATIONS
+#include "instrumented.h"
+#include "output_sink.h"
+
 namespace item25 {
 
     class Widget {
@@ -59,23 +63,56 @@ namespace item25 {
         Widget1 w;
         return std::move(w);   // move w into return value
     }                          // (don't do this!)
+
+    // the two again, counted: same size as Widget1, and the summary at exit
+    // shows which one moves
+    using CountedWidget1 = Instrumented<Widget1>;
+    static_assert(sizeof(CountedWidget1) == sizeof(Widget1), "no layout change");
+
+    CountedWidget1 makeCountedWidget() {
+        CountedWidget1 w;
+        return w;
+    }
+
+    // the same pessimizing move as makeWidget1; the warning is makeWidget1's
+    // to make, so it's silenced for the counted copy
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpessimizing-move"
+#endif
+    CountedWidget1 makeCountedWidget1() {
+        CountedWidget1 w;
+        return std::move(w);
+    }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
 }
 
 template<typename T>
 void f(T &&x)
 {
-    std :: cout << &x << '\n';  // same address
+    stdoutSink() << &x << '\n';   // same address
 }
 
 int main()
 {
     int x{10};
 
-    std :: cout << &x << '\n';
+    stdoutSink() << &x << '\n';
     f(x);   // same address
     f(std::move(x));    // same address
     f(5);   // different address
 
+    {
+        INSTRUMENT_SITE("item25: makeWidget, return w");
+        auto w = item25::makeCountedWidget();
+    }
+    {
+        INSTRUMENT_SITE("item25: makeWidget1, return std::move(w)");
+        auto w = item25::makeCountedWidget1();
+    }
+
     return 0;
 }
 
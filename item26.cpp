@@ -3,21 +3,43 @@
 #include <iostream>
 #include <string>
 #include <set>
+#include <unordered_map>
+#include <vector>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "bench.h"
+#include "flat_hash_map.h"
+#include "output_sink.h"
+
+// cmake -DCXX17_PMR=ON
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#define ITEM26_PMR 1
+#endif
 
 namespace item26 {
-    std::multiset<std::string> names;
+    // every name added, and how many times: a multiset, counted; it finds a
+    // name from a const char * without building a std::string
+#if defined(ITEM26_PMR)
+    // (the names, too, come from the map's memory resource)
+    FlatHashMap<std::pmr::string, std::size_t> names;
+#else
+    FlatHashMap<std::string, std::size_t> names;
+#endif
 
     void log(const std::chrono::time_point<std::chrono::system_clock> &t, const std :: string &&s) {
         std::time_t tt = std::chrono::system_clock::to_time_t(t);
-        std::cout << s << ": " << std::ctime(&tt);
+        stdoutSink() << s << ": " << std::ctime(&tt);
     }
 
     void logAndAdd(const std::string& name)
     {
         auto now = std::chrono::system_clock::now();
         log(now, "logAndAdd const string");
-        names.emplace(name);
+        ++names[name];
     }
 
     template<typename T>
@@ -25,7 +47,7 @@ namespace item26 {
     {
         auto now = std::chrono::system_clock::now();
         log(now, "logAndAdd universal ref");
-        names.emplace(std::forward<T>(name));
+        ++names[std::forward<T>(name)]; // a new name is built in place from name
     }
 
     // void logAndAdd(int idx) // new overload
@@ -41,7 +63,45 @@ namespace item26 {
 // overload vacuums up far more argument types than the developer doing the
 // overloading generally expects.
 
-int main()
+// ns per name added to each kind of registry, the names being string
+// literals (const char *) too long for the small string optimization
+template <typename Add>
+double addNs(const std::vector<const char *> &adds, Add add)
+{
+    return measureNs([&]
+                     {
+        for (const char *name : adds)
+            add(name); }) / adds.size();
+}
+
+void benchmarkNames(size_t n)
+{
+    std::vector<std::string> distinct(1000);
+    for (size_t i = 0; i != distinct.size(); ++i)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof buf, "Persephone the pet number %zu", i);
+        distinct[i] = buf;
+    }
+    std::mt19937 rng(26);
+    std::vector<const char *> adds(n);
+    for (auto &name : adds)
+        name = distinct[rng() % distinct.size()].c_str();
+
+    std::multiset<std::string> multiset;
+    std::unordered_map<std::string, std::size_t> map;
+    FlatHashMap<std::string, std::size_t> flat;
+    double ns[3] = {addNs(adds, [&](const char *name)
+                          { multiset.emplace(name); }),
+                    addNs(adds, [&](const char *name)
+                          { ++map[name]; }),
+                    addNs(adds, [&](const char *name)
+                          { ++flat[name]; })};
+    stdoutSink() << n << " names added (ns per name): multiset " << ns[0] << ", unordered_map " << ns[1]
+                 << ", FlatHashMap " << ns[2] << '\n';
+}
+
+int main(int argc, char *argv[])
 {
     std::string petName("Darla");
     item26::logAndAdd(petName); // pass lvalue std::string
@@ -49,17 +109,24 @@ int main()
     item26::logAndAdd("Patty Dog"); // pass string literal
 
     item26::logAndAdd(petName); // as before, copy
-                                // lvalue into multiset
+                                // lvalue into names
     item26::logAndAdd(std::string("Persephone"));   // move rvalue instead
                                                     // of copying it
     item26::logAndAdd("Patty Dog"); // create std::string
-                                    // in multiset instead
+                                    // in names instead
                                     // of copying a temporary
                                     // std::string
 
     const std::string s("Tralalero, Tralala");
     item26::logAndAdd(s);
 
+    stdoutSink() << "Patty Dog was added " << item26::names.find("Patty Dog")->second << " times\n";
+
+    // argv[1] names (default 1 million)
+    size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    if (n > 0)
+        benchmarkNames(n);
+
     return 0;
 }
 
@@ -1,11 +1,22 @@
 // Item 27: Familiarize yourself with alternatives to overloading on universal references.
 
 #include <iostream>
-#include <set>
 #include <chrono>
 
+#include "flat_hash_map.h"
+
+// cmake -DCXX17_PMR=ON
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#define ITEM27_PMR 1
+#endif
+
 namespace item27 {
-    std::multiset<std::string> names;
+#if defined(ITEM27_PMR)
+    FlatHashMap<std::pmr::string, std::size_t> names; // each name, and how many times it was added
+#else
+    FlatHashMap<std::string, std::size_t> names; // each name, and how many times it was added
+#endif
 
     void log(const std::chrono::time_point<std::chrono::system_clock> &t, const std :: string &&s) {
         const std::time_t tt = std::chrono::system_clock::to_time_t(t);
@@ -25,7 +36,7 @@ namespace item27 {
     { // add it to
             const auto &now = std::chrono::system_clock::now(); // global data
             log(now, "logAndAdd"); // structure
-            names.emplace(std::forward<T>(name));
+            ++names[std::forward<T>(name)];
     }
 
     std::string nameFromIdx(int idx);
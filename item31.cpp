@@ -4,8 +4,29 @@
 #include <vector>
 #include <functional>
 #include <algorithm>
+#include <cstdlib>
 
+#include "bench.h"
+#include "work_stealing_pool.h"
+
+// cmake -DCXX17_PMR=ON
+#if __cplusplus >= 201703L
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "flat_hash_map.h"
+#include "memory_resources.h"
+#define ITEM31_PMR 1
+#endif
+
+#if defined(ITEM31_PMR)
+// the vector takes a memory resource; std::function itself doesn't (C++17
+// dropped its allocator support), but a lambda that captures an int or two
+// is stored inside it
+using FilterContainer = std::pmr::vector<std::function<bool(int)>>;
+#else
 using FilterContainer = std::vector<std::function<bool(int)>>;
+#endif
 
 FilterContainer filters;
 
@@ -133,7 +154,114 @@ void Widget::addFilter() const
     // }
 }
 
-int main() {
+// how many of [0, n) pass every filter, on this thread and on the shared
+// work-stealing pool; the filters capture by value, so they can run anywhere
+void benchmarkFilters(int n) {
+    FilterContainer checks;
+    checks.emplace_back([](int value) { return value % 5 == 0; });
+    auto divisor = computeDivisor(computeSomeValue1(), computeSomeValue2());
+    checks.emplace_back([divisor](int value) { return value % divisor == 0; });
+    checks.emplace_back([](int value) { return value % 3 != 0; });
+
+    auto count = [&checks](int lo, int hi) {
+        long passed = 0;
+        for (int value = lo; value != hi; ++value)
+            passed += std::all_of(checks.begin(), checks.end(),
+                                  [value](const auto &filter) { return filter(value); });
+        return passed;
+    };
+
+    WorkStealingPool &pool = sharedPool();
+    long serial = 0, parallel = 0;
+    double serialNs = measureNs([&] { serial = count(0, n); });
+    double parallelNs = measureNs([&] {
+        parallel = pool.parallelReduce(0, n, 1 << 14, 0L, count,
+                                       [](long a, long b) { return a + b; });
+    });
+
+    std :: cout << serial << " of " << n << " values pass (ns per value): this thread "
+                << serialNs / n << ", " << pool.size() << "-thread pool " << parallelNs / n
+                << (serial == parallel ? "" : " (results differ!)") << '\n';
+}
+
+#if defined(ITEM31_PMR)
+// Item 19's Widget, for the request below
+class RequestWidget : public std::enable_shared_from_this<RequestWidget> {
+public:
+    explicit RequestWidget(int id) : id(id) {}
+
+    void process(std::pmr::vector<std::shared_ptr<RequestWidget>> &processed) {
+        processed.emplace_back(shared_from_this());
+    }
+
+    int id;
+};
+
+// One request, shaped like the demos: add the names it mentions (Item 26),
+// process its widgets (Item 19), run its values through its filters; then
+// drop all of it. Every container, and every Widget, is built on resource.
+long handleRequest(int r, const std::vector<std::string> &customers, std::pmr::memory_resource *resource) {
+    FlatHashMap<std::pmr::string, std::size_t> names(resource);
+    for (int i = 0; i != 64; ++i)
+        ++names[customers[(r * 7 + i * 13) % customers.size()]];
+
+    std::pmr::vector<std::shared_ptr<RequestWidget>> processed(resource);
+    std::pmr::polymorphic_allocator<RequestWidget> alloc(resource);
+    for (int i = 0; i != 32; ++i)
+        std::allocate_shared<RequestWidget>(alloc, r + i)->process(processed);
+
+    FilterContainer checks(resource);
+    int divisor = r % 7 + 2;
+    checks.emplace_back([divisor](int value) { return value % divisor == 0; });
+    checks.emplace_back([](int value) { return value % 3 != 0; });
+    long passed = 0;
+    for (const auto &widget : processed)
+        for (int value = widget->id; value != widget->id + 8; ++value)
+            passed += std::all_of(checks.begin(), checks.end(),
+                                  [value](const auto &filter) { return filter(value); });
+
+    return passed + static_cast<long>(names.size());
+}
+
+// ns per request with its containers on the default resource (new and
+// delete), on the thread-caching pool, and on an arena that's reset after
+// each request: after the first few, that one never calls the allocator
+void benchmarkRequests(int requests) {
+    std::vector<std::string> customers(256);
+    for (std::size_t i = 0; i != customers.size(); ++i) {
+        char buf[64];
+        std::snprintf(buf, sizeof buf, "Persephone the customer number %zu", i);
+        customers[i] = buf;
+    }
+
+    auto perRequestNs = [&](auto handle) {
+        long total = 0;
+        double ns = measureNs([&] {
+            for (int r = 0; r != requests; ++r)
+                total += handle(r);
+        });
+        doNotOptimize(total);
+        return ns / requests;
+    };
+
+    double defaultNs = perRequestNs([&](int r) {
+        return handleRequest(r, customers, std::pmr::get_default_resource());
+    });
+    PoolResource pool;
+    double poolNs = perRequestNs([&](int r) { return handleRequest(r, customers, &pool); });
+    RequestArena arena;
+    double arenaNs = perRequestNs([&](int r) {
+        RequestScope scope(arena); // resets the arena after the request's containers are gone
+        return handleRequest(r, customers, &arena);
+    });
+
+    std :: cout << requests << " requests (ns per request): default resource " << defaultNs
+                << ", PoolResource " << poolNs << ", RequestArena " << arenaNs << " ("
+                << arena.capacity() / 1024 << " KiB)\n";
+}
+#endif
+
+int main(int argc, char *argv[]) {
     filters.emplace_back(
         [](int value) { return value % 5 == 0; }
     );
@@ -148,6 +276,18 @@ int main() {
     //
     // std :: cout << ret << '\n';
 
+    // argv[1] values (default 2^24)
+    int n = argc > 1 ? std::atoi(argv[1]) : 1 << 24;
+    if (n > 0)
+        benchmarkFilters(n);
+
+#if defined(ITEM31_PMR)
+    // argv[2] requests (default 200000)
+    int requests = argc > 2 ? std::atoi(argv[2]) : 200000;
+    if (requests > 0)
+        benchmarkRequests(requests);
+#endif
+
     return 0;
 }
 
@@ -3,11 +3,27 @@
 #include <iostream>
 #include <chrono>
 #include <functional>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "enum_map.h"
+
+// cmake -DCXX20_COROUTINES=ON
+#if defined(__cpp_impl_coroutine)
+#include <algorithm>
+#include "task.h"
+#include "timer_wheel.h"
+#define ITEM34_COROUTINES 1
+#endif
 
 // typedef for a point in time (see Item 9 for syntax)
 using Time = std::chrono::steady_clock::time_point;
 // see Item 10 for "enum class"
 enum class Sound { Beep, Siren, Whistle };
+REFLECT_ENUM(Sound, Beep, Siren, Whistle);
 // typedef for a length of time
 using Duration = std::chrono::steady_clock::duration;
 // at time t, make sound s for duration d
@@ -15,7 +31,87 @@ void setAlarm(Time t, Sound s, Duration d) {
     std :: cout << "miau\n";
 }
 
-int main() {
+#if defined(ITEM34_COROUTINES)
+// setAlarm that callers can co_await: done once s has sounded for d
+Task<> alarm(TimerWheel &wheel, Time t, Sound s, Duration d) {
+    co_await wheel.sleepUntil(t);
+    std::cout << enumName(s) << " on\n";
+    co_await wheel.sleepUntil(t + d);
+    std::cout << enumName(s) << " off\n";
+}
+
+// one alarm after the other
+Task<> wakeUp(TimerWheel &wheel) {
+    using namespace std::literals;
+    co_await alarm(wheel, std::chrono::steady_clock::now() + 20ms, Sound::Beep, 10ms);
+    co_await alarm(wheel, std::chrono::steady_clock::now() + 5ms, Sound::Siren, 10ms);
+}
+
+Task<> sleeper(TimerWheel &wheel, Time due, Duration &lateBy) {
+    co_await wheel.sleepUntil(due);
+    lateBy = std::chrono::steady_clock::now() - due;
+}
+
+// n coroutines asleep at once, due at random times 0.5 s to 2.5 s out;
+// how late each one wakes up
+void benchmarkSleepers(std::size_t n) {
+    using namespace std::chrono;
+
+    TimerWheel wheel(100us);
+    std::vector<Duration> lateBy(n);
+    std::mt19937 rng(34);
+    std::uniform_int_distribution<long> dueIn(500000, 2500000);
+
+    std::size_t frameBytes = taskFrames().bytes;
+    Time now = steady_clock::now();
+    double spawnNs = measureNs([&] {
+        for (std::size_t i = 0; i != n; ++i)
+            spawn(sleeper(wheel, now + microseconds(dueIn(rng)), lateBy[i]));
+    });
+    std::cout << n << " sleepers: " << spawnNs / n << " ns to start each, "
+              << (taskFrames().bytes - frameBytes) / n << " bytes each while asleep\n";
+
+    double runNs = measureNs([&] { wheel.run(); });
+    std::sort(lateBy.begin(), lateBy.end());
+    auto us = [&](double q) {
+        return duration<double, std::micro>(lateBy[std::min(n - 1, std::size_t(q * n))]).count();
+    };
+    // min is negative if anybody woke early
+    std::cout << "  all awake after " << runNs / 1e6 << " ms; woken late by (us, 100 us ticks): min "
+              << us(0) << ", p50 " << us(0.5) << ", p90 " << us(0.9) << ", p99 " << us(0.99) << ", p99.9 " << us(0.999)
+              << ", max " << us(1) << '\n';
+}
+#endif
+
+// tallies argv[1] random sounds per Sound, keyed by hash map and by EnumMap
+void benchmarkSoundCounts(std::size_t n) {
+    std::vector<Sound> sounds(n);
+    std::mt19937 rng(34);
+    for (auto &s : sounds)
+        s = static_cast<Sound>(rng() % EnumTraits<Sound>::count());
+
+    std::unordered_map<Sound, std::size_t> hashed;
+    EnumMap<Sound, std::size_t> dense;
+
+    double hashedNs = measureNs([&] {
+        for (Sound s : sounds)
+            ++hashed[s];
+    });
+    double denseNs = measureNs([&] {
+        for (Sound s : sounds)
+            ++dense[s];
+    });
+    doNotOptimize(dense);
+
+    std::cout << n << " sounds counted (ns per sound): unordered_map " << hashedNs / n
+              << ", EnumMap " << denseNs / n << '\n';
+    dense.forEach([&](Sound s, std::size_t count) {
+        std::cout << "  " << enumName(s) << ": " << count
+                  << (count == hashed[s] ? "" : " (counts differ!)") << '\n';
+    });
+}
+
+int main(int argc, char *argv[]) {
     // The most important reason to prefer lambdas over std::bind is that lambdas are
     // more readable. Suppose, for example, we have a function to set up an audible alarm:
 
@@ -75,6 +171,38 @@ int main() {
         30s);
     }
 
+    // alarm lengths per sound: an array indexed by the enumerator, no hashing
+    {
+        using namespace std::literals;
+
+        EnumMap<Sound, Duration> alarmLength{
+            {Sound::Beep, 1s}, {Sound::Siren, 30s}, {Sound::Whistle, 5s}};
+        EnumSet<Sound> loud{Sound::Siren, Sound::Whistle};
+
+        loud.forEach([&](Sound s) {
+            std::cout << enumName(s) << " for "
+                      << std::chrono::duration_cast<std::chrono::seconds>(alarmLength[s]).count()
+                      << "s\n";
+        });
+    }
+
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t(1) << 24;
+    if (n > 0)
+        benchmarkSoundCounts(n);
+
+#if defined(ITEM34_COROUTINES)
+    {
+        TimerWheel wheel;
+        spawn(wakeUp(wheel)); // nothing blocks, nothing sounds yet
+        wheel.run();
+    }
+
+    // argv[2] sleepers (default 1 million)
+    std::size_t sleepers = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    if (sleepers > 0)
+        benchmarkSleepers(sleepers);
+#endif
+
     return 0;
 }
 
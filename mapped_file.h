@@ -0,0 +1,248 @@
+// RAII read-only memory mapping of a whole file (POSIX).
+//
+// Like unique_file_t in Item 18, a MappedFile exclusively owns its resource:
+// it's move-only, and the mapping and descriptor are released in the
+// destructor. bytes() is a zero-copy view of the file's contents.
+//
+// Records (lines, by default) are iterated straight out of the mapping with
+// RecordRange, so scanning a file costs no libc call per byte and no copy.
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Byte = unsigned char;
+
+// non-owning view of contiguous bytes (C++14 has no std::span)
+class ByteSpan
+{
+public:
+    constexpr ByteSpan() noexcept = default;
+    constexpr ByteSpan(const Byte *data, std::size_t size) noexcept : ptr(data), len(size) {}
+
+    constexpr const Byte *data() const noexcept { return ptr; }
+    constexpr std::size_t size() const noexcept { return len; }
+    constexpr bool empty() const noexcept { return len == 0; }
+    constexpr const Byte *begin() const noexcept { return ptr; }
+    constexpr const Byte *end() const noexcept { return ptr + len; }
+    constexpr Byte operator[](std::size_t i) const noexcept { return ptr[i]; }
+
+    constexpr ByteSpan subspan(std::size_t offset, std::size_t count) const noexcept
+    {
+        return ByteSpan(ptr + offset, count);
+    }
+
+    std::string str() const { return std::string(reinterpret_cast<const char *>(ptr), len); }
+
+private:
+    const Byte *ptr = nullptr;
+    std::size_t len = 0;
+};
+
+class MappedFile
+{
+public:
+    enum class Access
+    {
+        Normal,
+        Sequential, // aggressive read-ahead, pages dropped behind the reader
+        Random,     // no read-ahead
+        WillNeed    // start faulting the whole file in now
+    };
+
+    MappedFile() noexcept = default;
+
+    // throws std::system_error if the file can't be opened or mapped
+    explicit MappedFile(const char *path, Access access = Access::Normal)
+    {
+        fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+            fail(path);
+        len = static_cast<std::size_t>(st.st_size);
+
+        // mmap rejects zero-length mappings; an empty file is an empty span
+        if (len != 0)
+        {
+            void *p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+                fail(path);
+            addr = static_cast<const Byte *>(p);
+        }
+
+        advise(access);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&rhs) noexcept
+        : fd(std::exchange(rhs.fd, -1)),
+          addr(std::exchange(rhs.addr, nullptr)),
+          len(std::exchange(rhs.len, 0))
+    {
+    }
+
+    MappedFile &operator=(MappedFile &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            fd = std::exchange(rhs.fd, -1);
+            addr = std::exchange(rhs.addr, nullptr);
+            len = std::exchange(rhs.len, 0);
+        }
+        return *this;
+    }
+
+    ~MappedFile() { reset(); }
+
+    explicit operator bool() const noexcept { return fd >= 0; }
+
+    ByteSpan bytes() const noexcept { return ByteSpan(addr, len); }
+    std::size_t size() const noexcept { return len; }
+
+    // only a hint; failures are ignored
+    void advise(Access access) const noexcept
+    {
+        if (len == 0)
+            return;
+
+        int advice = MADV_NORMAL;
+        switch (access)
+        {
+        case Access::Normal:
+            advice = MADV_NORMAL;
+            break;
+        case Access::Sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case Access::Random:
+            advice = MADV_RANDOM;
+            break;
+        case Access::WillNeed:
+            advice = MADV_WILLNEED;
+            break;
+        }
+        ::madvise(const_cast<Byte *>(addr), len, advice);
+    }
+
+    void reset() noexcept
+    {
+        if (addr)
+            ::munmap(const_cast<Byte *>(addr), len);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+        addr = nullptr;
+        len = 0;
+    }
+
+private:
+    [[noreturn]] void fail(const char *path)
+    {
+        int err = errno;
+        reset();
+        throw std::system_error(err, std::generic_category(), path);
+    }
+
+    int fd = -1;
+    const Byte *addr = nullptr;
+    std::size_t len = 0;
+};
+
+// Forward iteration over delimiter-separated records of a byte range. Each
+// record is a ByteSpan into the mapping, without its delimiter; a final
+// record without a trailing delimiter is still produced.
+class RecordIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ByteSpan;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ByteSpan *;
+    using reference = const ByteSpan &;
+
+    RecordIterator() noexcept = default;
+    RecordIterator(const Byte *first, const Byte *last, Byte delim) noexcept
+        : pos(first), last(last), delim(delim)
+    {
+        advance();
+    }
+
+    reference operator*() const noexcept { return current; }
+    pointer operator->() const noexcept { return &current; }
+
+    RecordIterator &operator++() noexcept
+    {
+        advance();
+        return *this;
+    }
+
+    RecordIterator operator++(int) noexcept
+    {
+        auto old = *this;
+        advance();
+        return old;
+    }
+
+    friend bool operator==(const RecordIterator &a, const RecordIterator &b) noexcept
+    {
+        return a.current.data() == b.current.data();
+    }
+    friend bool operator!=(const RecordIterator &a, const RecordIterator &b) noexcept
+    {
+        return !(a == b);
+    }
+
+private:
+    void advance() noexcept
+    {
+        if (pos == last)
+        {
+            current = ByteSpan(); // end
+            return;
+        }
+
+        // memchr is vectorized in libc, unlike a byte-by-byte loop
+        auto hit = static_cast<const Byte *>(std::memchr(pos, delim, last - pos));
+        auto stop = hit ? hit : last;
+        current = ByteSpan(pos, stop - pos);
+        pos = hit ? hit + 1 : last;
+    }
+
+    const Byte *pos = nullptr;
+    const Byte *last = nullptr;
+    Byte delim = '\n';
+    ByteSpan current;
+};
+
+class RecordRange
+{
+public:
+    explicit RecordRange(ByteSpan bytes, Byte delim = '\n') noexcept
+        : bytes(bytes), delim(delim)
+    {
+    }
+
+    RecordIterator begin() const noexcept { return RecordIterator(bytes.begin(), bytes.end(), delim); }
+    RecordIterator end() const noexcept { return RecordIterator(); }
+
+private:
+    ByteSpan bytes;
+    Byte delim;
+};
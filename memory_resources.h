@@ -0,0 +1,191 @@
+// Memory resources for the demo containers (C++17 std::pmr).
+//
+// A container built on a std::pmr::memory_resource * takes every allocation
+// from it, whatever the element type, so where a container's memory comes
+// from becomes a decision made where the container is built rather than in
+// its type. Three kinds are useful here:
+//
+//   monotonic  std::pmr::monotonic_buffer_resource: bump allocation,
+//              deallocation does nothing, everything is freed at once when
+//              the resource goes away. For data that only grows.
+//   pooled     PoolResource: the thread-caching size-class pool of
+//              pool_allocator.h. Freed blocks are reused, and any thread may
+//              free a block; for long-lived, shared containers.
+//   arena      RequestArena: monotonic, and reset() makes all of its memory
+//              available again without giving any of it back, so a server
+//              that handles one request at a time per arena stops calling
+//              the global allocator once the arena has grown to fit.
+//
+// Containers on an arena must be gone, or never touched again, before the
+// arena is reset; a RequestScope declared ahead of them in a block gets the
+// order right:
+//
+//     RequestArena arena;
+//     for (const auto &request : requests)
+//     {
+//         RequestScope scope(arena);
+//         std::pmr::vector<std::pmr::string> words(&arena);
+//         ...
+//     } // words is destroyed, then the arena is reset
+
+#pragma once
+
+#if __cplusplus < 201703L || !__has_include(<memory_resource>)
+#error "memory_resources.h needs C++17 <memory_resource>"
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "pool_allocator.h"
+
+class PoolResource final : public std::pmr::memory_resource
+{
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        // the pool only guarantees max_align_t
+        if (alignment > pool::detail::kAlignment)
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        return pool::detail::allocate(bytes);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        if (alignment > pool::detail::kAlignment)
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        else
+            pool::detail::deallocate(p);
+    }
+
+    // the pool is global: any two PoolResources can free each other's blocks
+    bool do_is_equal(const std::pmr::memory_resource &rhs) const noexcept override
+    {
+        return dynamic_cast<const PoolResource *>(&rhs) != nullptr;
+    }
+};
+
+// not thread-safe: one arena per thread, or per request in flight
+class RequestArena final : public std::pmr::memory_resource
+{
+public:
+    explicit RequestArena(std::size_t initialBytes = 64 * 1024,
+                          std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : upstream(upstream)
+    {
+        addChunk(initialBytes);
+    }
+
+    RequestArena(const RequestArena &) = delete;
+    RequestArena &operator=(const RequestArena &) = delete;
+
+    ~RequestArena() override { releaseChunks(); }
+
+    // everything allocated so far is dead; a request that outgrew the arena
+    // leaves it as one chunk big enough for all of that request
+    void reset() noexcept
+    {
+        if (chunks.size() > 1)
+        {
+            std::size_t total = capacity();
+            void *merged = nullptr;
+            try
+            {
+                merged = upstream->allocate(total, alignof(std::max_align_t));
+            }
+            catch (...) // keep the chunks, and start again from the first
+            {
+            }
+            if (merged)
+            {
+                releaseChunks();
+                chunks.push_back(Chunk{static_cast<char *>(merged), total}); // clear() kept the capacity
+            }
+        }
+        next = chunks.front().data;
+        end = next + chunks.front().size;
+        used = 0;
+    }
+
+    std::size_t capacity() const noexcept
+    {
+        std::size_t total = 0;
+        for (const Chunk &c : chunks)
+            total += c.size;
+        return total;
+    }
+
+    // handed out since the last reset, padding included
+    std::size_t bytesUsed() const noexcept { return used; }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        auto p = alignUp(next, alignment);
+        // aligning may go past the end of a chunk that ends unaligned
+        if (p > end || bytes > static_cast<std::size_t>(end - p))
+        {
+            // the chunks double, so a request needs few of them
+            addChunk(std::max(bytes + alignment, chunks.back().size * 2));
+            p = alignUp(next, alignment);
+        }
+        used += p + bytes - next;
+        next = p + bytes;
+        return p;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &rhs) const noexcept override { return this == &rhs; }
+
+private:
+    struct Chunk
+    {
+        char *data;
+        std::size_t size;
+    };
+
+    static char *alignUp(char *p, std::size_t alignment) noexcept
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((alignment - address % alignment) % alignment);
+    }
+
+    void addChunk(std::size_t size)
+    {
+        chunks.reserve(chunks.size() + 1); // so push_back can't throw and leak the chunk
+        auto data = static_cast<char *>(upstream->allocate(size, alignof(std::max_align_t)));
+        chunks.push_back(Chunk{data, size});
+        next = data;
+        end = data + size;
+    }
+
+    void releaseChunks() noexcept
+    {
+        for (const Chunk &c : chunks)
+            upstream->deallocate(c.data, c.size, alignof(std::max_align_t));
+        chunks.clear();
+    }
+
+    std::pmr::memory_resource *upstream;
+    std::vector<Chunk> chunks;
+    char *next = nullptr;
+    char *end = nullptr;
+    std::size_t used = 0;
+};
+
+// resets the arena when it goes out of scope
+class RequestScope
+{
+public:
+    explicit RequestScope(RequestArena &arena) noexcept : arena(arena) {}
+    RequestScope(const RequestScope &) = delete;
+    RequestScope &operator=(const RequestScope &) = delete;
+    ~RequestScope() { arena.reset(); }
+
+private:
+    RequestArena &arena;
+};
@@ -0,0 +1,474 @@
+// Buffered output straight to a file descriptor.
+//
+// OutputSink formats into a buffer owned by the calling thread, so
+// sink << x takes no lock and shares nothing with other threads: no
+// locale, no stream state, no synchronization with stdio per call.
+// Integers and pointers are converted with a hand-rolled to_chars (C++14
+// has no <charconv>); floating point goes through snprintf("%g"), which
+// matches std::cout's default format.
+//
+// A full buffer is written with one write(2), up to its last complete line,
+// so lines from different threads never interleave. flush() empties the
+// calling thread's buffer, and flushAll() empties every thread's buffer
+// with a single writev(2); other threads may keep writing meanwhile, though
+// a line one of them is halfway through then comes out in two pieces. The
+// destructor flushes everything, and a thread's buffer is flushed, and
+// handed back to the sink, when the thread exits.
+//
+// Appending stays lock-free: the owner publishes each append with a release
+// store of the buffer's fill level, and flushAll() writes out only what has
+// been published. The buffer's mutex is taken for the rare drain of a full
+// buffer, and by flushAll(), so the two never move data under each other.
+//
+// stdoutSink() is a process-wide sink on descriptor 1, flushed at exit. It
+// fflush()es stdout before every write, so output sent earlier through
+// std::cout or printf still comes out first.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace detail
+{
+    static const char kDigitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // writes the decimal digits of value so that they end at `end`;
+    // returns where they start
+    template <typename U>
+    inline char *formatDecimalDigits(char *end, U value) noexcept
+    {
+        while (value >= 100)
+        {
+            auto pair = static_cast<unsigned>(value % 100) * 2;
+            value /= 100;
+            *--end = kDigitPairs[pair + 1];
+            *--end = kDigitPairs[pair];
+        }
+        if (value >= 10)
+        {
+            auto pair = static_cast<unsigned>(value) * 2;
+            *--end = kDigitPairs[pair + 1];
+            *--end = kDigitPairs[pair];
+        }
+        else
+            *--end = static_cast<char>('0' + value);
+        return end;
+    }
+
+    inline char *formatDecimal(char *end, std::uint64_t value) noexcept
+    {
+        // 32-bit divisions are cheaper, and most values fit
+        if (value <= UINT32_MAX)
+            return formatDecimalDigits(end, static_cast<std::uint32_t>(value));
+        return formatDecimalDigits(end, value);
+    }
+
+    inline unsigned decimalDigits(std::uint64_t value) noexcept
+    {
+        unsigned n = 1;
+        for (;;)
+        {
+            if (value < 10)
+                return n;
+            if (value < 100)
+                return n + 1;
+            if (value < 1000)
+                return n + 2;
+            if (value < 10000)
+                return n + 3;
+            value /= 10000;
+            n += 4;
+        }
+    }
+
+    // two hex digits at a time
+    inline char *formatHex(char *end, std::uintptr_t value) noexcept
+    {
+        static const char digits[] = "0123456789abcdef";
+        while (value >= 16)
+        {
+            *--end = digits[value & 15];
+            *--end = digits[(value >> 4) & 15];
+            value >>= 8;
+        }
+        if (value)
+            *--end = digits[value];
+        return end;
+    }
+
+    inline unsigned hexDigits(std::uintptr_t value) noexcept
+    {
+#if defined(__GNUC__)
+        return value ? (sizeof(value) * 8 - __builtin_clzll(value) + 3) / 4 : 1;
+#else
+        unsigned n = 1;
+        while (value >>= 4)
+            ++n;
+        return n;
+#endif
+    }
+
+    // writes all of [iov, iov + count), retrying on EINTR and short writes
+    inline void writeAll(int fd, iovec *iov, int count)
+    {
+        while (count > 0)
+        {
+            ssize_t n = ::writev(fd, iov, std::min(count, IOV_MAX));
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "OutputSink: writev");
+            }
+            for (; count > 0 && static_cast<std::size_t>(n) >= iov->iov_len; ++iov, --count)
+                n -= iov->iov_len;
+            if (count > 0)
+            {
+                iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+    }
+}
+
+class OutputSink
+{
+public:
+    explicit OutputSink(int fd, std::size_t bufferSize = std::size_t(1) << 16)
+        : state(std::make_shared<State>(fd, std::max<std::size_t>(bufferSize, 64))),
+          id(state->id),
+          size(state->size)
+    {
+    }
+
+    OutputSink(const OutputSink &) = delete;
+    OutputSink &operator=(const OutputSink &) = delete;
+
+    ~OutputSink()
+    {
+        try
+        {
+            flushAll();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    OutputSink &operator<<(char c)
+    {
+        Buffer &b = local();
+        *reserve(b, 1) = c;
+        b.commit(1);
+        return *this;
+    }
+
+    OutputSink &operator<<(signed char c) { return *this << static_cast<char>(c); }
+    OutputSink &operator<<(unsigned char c) { return *this << static_cast<char>(c); }
+
+    OutputSink &operator<<(const char *s) { return append(s, std::strlen(s)); }
+    OutputSink &operator<<(const std::string &s) { return append(s.data(), s.size()); }
+
+    // formatted in place, straight into the buffer
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    OutputSink &operator<<(T value)
+    {
+        Buffer &b = local();
+        char *start = reserve(b, 20);
+        char *out = start;
+        auto magnitude = static_cast<std::uint64_t>(value);
+        if (std::is_signed<T>::value && value < 0)
+        {
+            *out++ = '-';
+            magnitude = 0 - magnitude;
+        }
+        out += detail::decimalDigits(magnitude);
+        detail::formatDecimal(out, magnitude);
+        b.commit(out - start);
+        return *this;
+    }
+
+    OutputSink &operator<<(bool value) { return *this << (value ? '1' : '0'); }
+
+    OutputSink &operator<<(double value)
+    {
+        char text[32];
+        int n = std::snprintf(text, sizeof text, "%g", value);
+        return append(text, static_cast<std::size_t>(n));
+    }
+
+    // like std::cout: 0x... for non-null pointers, 0 for null ones
+    OutputSink &operator<<(const void *p)
+    {
+        if (!p)
+            return *this << '0';
+
+        auto value = reinterpret_cast<std::uintptr_t>(p);
+        unsigned n = detail::hexDigits(value);
+
+        Buffer &b = local();
+        char *out = reserve(b, 2 + n);
+        out[0] = '0';
+        out[1] = 'x';
+        detail::formatHex(out + 2 + n, value);
+        b.commit(2 + n);
+        return *this;
+    }
+
+    OutputSink &append(const char *data, std::size_t size) { return append(local(), data, size); }
+
+    // writes out the calling thread's buffer
+    void flush() { drain(*state, local(), false); }
+
+    // writes out every thread's buffer in one writev, partial lines
+    // included; the owners may go on appending meanwhile
+    void flushAll()
+    {
+        std::lock_guard<std::mutex> lock(state->m);
+        std::vector<std::unique_lock<std::mutex>> locks;
+        std::vector<std::size_t> published;
+        std::vector<iovec> iov;
+        locks.reserve(state->buffers.size());
+        published.reserve(state->buffers.size());
+        for (auto &b : state->buffers)
+        {
+            locks.emplace_back(b->m);
+            published.push_back(b->used.load(std::memory_order_acquire));
+            if (published.back() > b->taken)
+                iov.push_back(iovec{b->data.get() + b->taken, published.back() - b->taken});
+        }
+        state->syncStdio();
+        detail::writeAll(state->fd, iov.data(), static_cast<int>(iov.size()));
+        for (std::size_t i = 0; i != published.size(); ++i)
+            state->buffers[i]->taken = published[i];
+    }
+
+private:
+    struct Buffer
+    {
+        explicit Buffer(std::size_t size) : data(new char[size]) {}
+
+        // owner only
+        std::size_t size() const noexcept { return used.load(std::memory_order_relaxed); }
+        char *end() noexcept { return data.get() + size(); }
+        void commit(std::size_t n) noexcept { used.store(size() + n, std::memory_order_release); }
+
+        std::unique_ptr<char[]> data;
+        std::atomic<std::size_t> used{0}; // written by the owner only
+        std::size_t taken = 0;            // the front bytes flushAll() wrote; guarded by m
+        std::mutex m;                     // held to drain, and by flushAll()
+    };
+
+    struct State
+    {
+        State(int fd, std::size_t size) : fd(fd), size(size), id(nextId()) {}
+
+        static std::uint64_t nextId() noexcept
+        {
+            static std::atomic<std::uint64_t> counter{0};
+            return ++counter;
+        }
+
+        void syncStdio() const
+        {
+            if (fd == STDOUT_FILENO)
+                std::fflush(stdout);
+        }
+
+        // frees the buffer of a thread that's exiting
+        void release(Buffer *buffer)
+        {
+            std::lock_guard<std::mutex> lock(m);
+            auto it = std::find_if(buffers.begin(), buffers.end(),
+                                   [buffer](const std::unique_ptr<Buffer> &b)
+                                   { return b.get() == buffer; });
+            if (it != buffers.end())
+            {
+                std::swap(*it, buffers.back());
+                buffers.pop_back();
+            }
+        }
+
+        const int fd;
+        const std::size_t size;
+        const std::uint64_t id; // never reused, unlike addresses
+        std::mutex m;           // guards buffers (registration, flushAll);
+                                // taken before any buffer's m
+        std::vector<std::unique_ptr<Buffer>> buffers;
+    };
+
+    // this thread's buffers, one per sink it has written to
+    struct LocalBuffers
+    {
+        struct Entry
+        {
+            std::weak_ptr<State> state;
+            std::uint64_t id;
+            Buffer *buffer;
+        };
+
+        ~LocalBuffers()
+        {
+            for (auto &e : entries)
+                if (auto s = e.state.lock())
+                    try
+                    {
+                        drain(*s, *e.buffer, false);
+                        s->release(e.buffer);
+                    }
+                    catch (...)
+                    {
+                    }
+        }
+
+        std::vector<Entry> entries;
+    };
+
+    // the buffer this thread used last; trivially constructible, so getting
+    // at it needs no initialization check
+    struct LastUsed
+    {
+        std::uint64_t id;
+        Buffer *buffer;
+    };
+
+    static LastUsed &lastUsed() noexcept
+    {
+        static thread_local LastUsed last{0, nullptr};
+        return last;
+    }
+
+    static LocalBuffers &localBuffers()
+    {
+        static thread_local LocalBuffers buffers;
+        return buffers;
+    }
+
+    Buffer &local()
+    {
+        LastUsed &last = lastUsed();
+        if (last.id == id)
+            return *last.buffer;
+        return switchTo(last);
+    }
+
+    Buffer &switchTo(LastUsed &last)
+    {
+        LocalBuffers &lb = localBuffers();
+        auto it = std::find_if(lb.entries.begin(), lb.entries.end(),
+                               [this](const LocalBuffers::Entry &e)
+                               { return e.id == state->id; });
+        if (it == lb.entries.end())
+        {
+            // forget sinks that are gone, then register with this one
+            lb.entries.erase(std::remove_if(lb.entries.begin(), lb.entries.end(),
+                                            [](const LocalBuffers::Entry &e)
+                                            { return e.state.expired(); }),
+                             lb.entries.end());
+
+            auto buffer = std::make_unique<Buffer>(state->size);
+            {
+                std::lock_guard<std::mutex> lock(state->m);
+                state->buffers.push_back(std::move(buffer));
+                lb.entries.push_back({state, state->id, state->buffers.back().get()});
+            }
+            it = lb.entries.end() - 1;
+        }
+        last = LastUsed{id, it->buffer};
+        return *last.buffer;
+    }
+
+    // room for n more bytes at the end of b
+    char *reserve(Buffer &b, std::size_t n)
+    {
+        if (b.size() + n > size)
+        {
+            drain(*state, b, true);
+            if (b.size() + n > size) // the partial line left is too long
+                drain(*state, b, false);
+        }
+        return b.end();
+    }
+
+    OutputSink &append(Buffer &b, const char *data, std::size_t size)
+    {
+        if (size > this->size) // too big to buffer
+        {
+            drain(*state, b, false);
+            iovec iov{const_cast<char *>(data), size};
+            state->syncStdio();
+            detail::writeAll(state->fd, &iov, 1);
+            return *this;
+        }
+        std::memcpy(reserve(b, size), data, size);
+        b.commit(size);
+        return *this;
+    }
+
+    // writes out b (what flushAll() hasn't already); with wholeLines, only
+    // up to its last newline (if it has one), and the partial line moves to
+    // the front. Called by b's owner only.
+    static void drain(State &s, Buffer &b, bool wholeLines)
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        std::size_t from = b.taken, used = b.size(), n = used;
+        if (wholeLines)
+        {
+            auto nl = static_cast<const char *>(::memrchr(b.data.get() + from, '\n', used - from));
+            if (nl)
+                n = nl - b.data.get() + 1;
+            else if (from != 0) // flushAll() cut the line; keep the rest
+                n = from;
+        }
+        if (n == 0)
+            return;
+
+        if (n != from)
+        {
+            iovec iov{b.data.get() + from, n - from};
+            s.syncStdio();
+            detail::writeAll(s.fd, &iov, 1);
+        }
+        std::memmove(b.data.get(), b.data.get() + n, used - n);
+        b.taken = 0;
+        b.used.store(used - n, std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<State> state;
+    std::uint64_t id;  // state->id
+    std::size_t size;  // state->size
+};
+
+// descriptor 1; never destroyed, flushed at exit
+inline OutputSink &stdoutSink()
+{
+    static OutputSink *sink = []
+    {
+        auto s = new OutputSink(STDOUT_FILENO);
+        std::atexit([]
+                    { stdoutSink().flushAll(); });
+        return s;
+    }();
+    return *sink;
+}
@@ -0,0 +1,179 @@
+// Array of enumerators packed Bits to an element.
+//
+// PackedEnumArray<E, Bits> keeps 64 / Bits enumerators in each 64-bit word.
+// By default an enumerator is stored as its underlying value (what Item 10's
+// toUType returns), which suits dense enums like Color or Food. Enums with
+// sparse values specialize PackedEnumCodes to map them to 0, 1, 2, ...
+//
+// count() and findFirst() never unpack elements one at a time: they compare
+// a whole word against the wanted code and count or locate the matching
+// fields with bit tricks (SIMD within a register), so a 2-bit array is
+// scanned 32 elements per step. histogram() does the same for each of the
+// 2 or 4 codes of 1- and 2-bit fields, in one pass over the words; with 16
+// or 256 codes a compare per code would cost more than unpacking, so it
+// unpacks.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+template <typename E>
+struct PackedEnumCodes
+{
+    static constexpr unsigned encode(E e) noexcept
+    {
+        return static_cast<unsigned>(static_cast<std::underlying_type_t<E>>(e));
+    }
+
+    static constexpr E decode(unsigned code) noexcept { return static_cast<E>(code); }
+};
+
+template <typename E, unsigned Bits>
+class PackedEnumArray
+{
+    static_assert(std::is_enum<E>::value, "PackedEnumArray holds enumerators");
+    static_assert(Bits == 1 || Bits == 2 || Bits == 4 || Bits == 8,
+                  "fields must not straddle words");
+
+    using Word = std::uint64_t;
+    using Codes = PackedEnumCodes<E>;
+
+    static constexpr unsigned kPerWord = 64 / Bits;
+    static constexpr Word kFieldMask = (Word(1) << Bits) - 1;
+
+public:
+    static constexpr unsigned kCodes = 1u << Bits;
+
+    PackedEnumArray() = default;
+    explicit PackedEnumArray(std::size_t n, E value = Codes::decode(0)) { resize(n, value); }
+
+    std::size_t size() const noexcept { return n; }
+    std::size_t bytes() const noexcept { return words.capacity() * sizeof(Word); }
+
+    E operator[](std::size_t i) const noexcept { return Codes::decode(code(i)); }
+
+    void set(std::size_t i, E value) noexcept
+    {
+        Word &w = words[i / kPerWord];
+        unsigned shift = i % kPerWord * Bits;
+        w = (w & ~(kFieldMask << shift)) | (Word(encode(value)) << shift);
+    }
+
+    void push_back(E value)
+    {
+        if (n % kPerWord == 0)
+            words.push_back(0);
+        ++n;
+        set(n - 1, value);
+    }
+
+    void resize(std::size_t count, E value = Codes::decode(0))
+    {
+        std::size_t old = n;
+        n = count;
+        words.resize((n + kPerWord - 1) / kPerWord, splat(encode(value)));
+        for (std::size_t i = old; i < n && i % kPerWord != 0; ++i)
+            set(i, value);
+    }
+
+    // how many elements equal value
+    std::size_t count(E value) const noexcept
+    {
+        const Word pattern = splat(encode(value));
+        std::size_t total = 0;
+        for (std::size_t w = 0; w != words.size(); ++w)
+            total += popcount(matches(words[w], pattern) & validMask(w));
+        return total;
+    }
+
+    // element counts indexed by code (by toUType for default codes)
+    std::array<std::size_t, kCodes> histogram() const noexcept
+    {
+        std::array<std::size_t, kCodes> counts{};
+        if (Bits <= 2)
+        {
+            for (std::size_t w = 0; w != words.size(); ++w)
+                for (unsigned c = 0; c != kCodes; ++c)
+                    counts[c] += popcount(matches(words[w], splat(c)) & validMask(w));
+        }
+        else
+        {
+            for (std::size_t i = 0; i != n; ++i)
+                ++counts[code(i)];
+        }
+        return counts;
+    }
+
+    // index of the first element equal to value, or size()
+    std::size_t findFirst(E value) const noexcept
+    {
+        const Word pattern = splat(encode(value));
+        for (std::size_t w = 0; w != words.size(); ++w)
+            if (Word m = matches(words[w], pattern) & validMask(w))
+                return w * kPerWord + ctz(m) / Bits;
+        return n;
+    }
+
+private:
+    static unsigned encode(E value) noexcept { return Codes::encode(value) & kFieldMask; }
+
+    unsigned code(std::size_t i) const noexcept
+    {
+        return (words[i / kPerWord] >> (i % kPerWord * Bits)) & kFieldMask;
+    }
+
+    // code repeated in every field of a word
+    static constexpr Word splat(unsigned code) noexcept
+    {
+        return ~Word(0) / kFieldMask * code;
+    }
+
+    // the lowest bit of each field that equals the matching field of
+    // pattern, and no other bits
+    static Word matches(Word w, Word pattern) noexcept
+    {
+        constexpr Word lowBits = ~Word(0) / kFieldMask;
+        Word diff = w ^ pattern;
+        for (unsigned s = 1; s < Bits; s <<= 1)
+            diff |= diff >> s; // fold each field's bits down onto its lowest
+        return ~diff & lowBits;
+    }
+
+    // all bits of word w that hold elements (the last word may be partial)
+    Word validMask(std::size_t w) const noexcept
+    {
+        std::size_t used = n - w * kPerWord;
+        return used >= kPerWord ? ~Word(0) : (Word(1) << (used * Bits)) - 1;
+    }
+
+    static unsigned popcount(Word w) noexcept
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(w);
+#else
+        unsigned c = 0;
+        for (; w; w &= w - 1)
+            ++c;
+        return c;
+#endif
+    }
+
+    static unsigned ctz(Word w) noexcept
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(w);
+#else
+        unsigned c = 0;
+        for (; !(w & 1); w >>= 1)
+            ++c;
+        return c;
+#endif
+    }
+
+    std::vector<Word> words;
+    std::size_t n = 0;
+};
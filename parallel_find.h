@@ -0,0 +1,255 @@
+// std::find split across a thread pool.
+//
+// parallelFind() cuts a random-access range into fixed-size chunks that the
+// pool's workers claim in ascending order. A worker that finds a match
+// records it (keeping the earliest) and stops; chunks that start after the
+// best match so far are never searched, and every chunk before it has
+// already been claimed, so the result is exactly what std::find would
+// return. Other iterator categories fall back to std::find.
+//
+// The calling thread searches too, so a pool of n workers gives n + 1
+// searchers (and a pool of none still works).
+//
+// Contiguous ranges (pointers and std::vector iterators) of arithmetic
+// elements are scanned 16 bytes at a time with SSE2 compares where
+// available.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define PARALLEL_FIND_SSE2 1
+#endif
+
+#include "thread_pool.h"
+
+namespace detail
+{
+    // SimdEq<T>::mask(p) has bit i set when byte i of the 16 bytes at p
+    // belongs to an element equal to the value; only the specializations
+    // below are usable
+    template <typename T, typename = void>
+    struct SimdEq
+    {
+        static constexpr bool enabled = false;
+    };
+
+#if defined(PARALLEL_FIND_SSE2)
+    template <std::size_t Size>
+    struct IntEq;
+
+    template <>
+    struct IntEq<1>
+    {
+        static __m128i splat(std::int8_t v) { return _mm_set1_epi8(v); }
+        static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+    };
+
+    template <>
+    struct IntEq<2>
+    {
+        static __m128i splat(std::int16_t v) { return _mm_set1_epi16(v); }
+        static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+    };
+
+    template <>
+    struct IntEq<4>
+    {
+        static __m128i splat(std::int32_t v) { return _mm_set1_epi32(v); }
+        static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+    };
+
+    template <>
+    struct IntEq<8>
+    {
+        static __m128i splat(std::int64_t v) { return _mm_set1_epi64x(v); }
+
+        // SSE2 has no 64-bit compare: both 32-bit halves must match
+        static __m128i eq(__m128i a, __m128i b)
+        {
+            __m128i e = _mm_cmpeq_epi32(a, b);
+            return _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));
+        }
+    };
+
+    template <typename T>
+    struct SimdEq<T, std::enable_if_t<std::is_integral<T>::value>>
+    {
+        static constexpr bool enabled = true;
+        using Int = IntEq<sizeof(T)>;
+
+        explicit SimdEq(T value) : v(Int::splat(value)) {}
+
+        int mask(const T *p) const
+        {
+            auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            return _mm_movemask_epi8(Int::eq(block, v));
+        }
+
+        __m128i v;
+    };
+
+    template <>
+    struct SimdEq<float>
+    {
+        static constexpr bool enabled = true;
+
+        explicit SimdEq(float value) : v(_mm_set1_ps(value)) {}
+
+        int mask(const float *p) const
+        {
+            return _mm_movemask_epi8(_mm_castps_si128(_mm_cmpeq_ps(_mm_loadu_ps(p), v)));
+        }
+
+        __m128 v;
+    };
+
+    template <>
+    struct SimdEq<double>
+    {
+        static constexpr bool enabled = true;
+
+        explicit SimdEq(double value) : v(_mm_set1_pd(value)) {}
+
+        int mask(const double *p) const
+        {
+            return _mm_movemask_epi8(_mm_castpd_si128(_mm_cmpeq_pd(_mm_loadu_pd(p), v)));
+        }
+
+        __m128d v;
+    };
+
+    template <typename T>
+    const T *findContiguous(const T *first, const T *last, const T &value, std::true_type)
+    {
+        constexpr std::ptrdiff_t kLanes = 16 / sizeof(T);
+        const SimdEq<T> eq(value);
+
+        // four registers per round keep the loop branch off the critical path
+        for (; last - first >= 4 * kLanes; first += 4 * kLanes)
+        {
+            int m0 = eq.mask(first);
+            int m1 = eq.mask(first + kLanes);
+            int m2 = eq.mask(first + 2 * kLanes);
+            int m3 = eq.mask(first + 3 * kLanes);
+            if ((m0 | m1 | m2 | m3) == 0)
+                continue;
+
+            int masks[] = {m0, m1, m2, m3};
+            for (int i = 0;; ++i)
+                if (masks[i])
+                    return first + i * kLanes + __builtin_ctz(masks[i]) / sizeof(T);
+        }
+        for (; last - first >= kLanes; first += kLanes)
+            if (int m = eq.mask(first))
+                return first + __builtin_ctz(m) / sizeof(T);
+        return std::find(first, last, value);
+    }
+#endif
+
+    template <typename V, typename T>
+    const V *findContiguous(const V *first, const V *last, const T &value, std::false_type)
+    {
+        return std::find(first, last, value);
+    }
+
+    template <typename It>
+    struct IsContiguous
+    {
+        using V = typename std::iterator_traits<It>::value_type;
+
+        static constexpr bool value =
+            std::is_pointer<It>::value ||
+            (!std::is_same<V, bool>::value &&
+             (std::is_same<It, typename std::vector<V>::iterator>::value ||
+              std::is_same<It, typename std::vector<V>::const_iterator>::value));
+    };
+
+    // index of the first element of [first + begin, first + end) equal to
+    // value, or end
+    template <typename It, typename T>
+    std::size_t findInChunk(It first, std::size_t begin, std::size_t end, const T &value,
+                            std::true_type /* contiguous */)
+    {
+        using V = typename std::iterator_traits<It>::value_type;
+        using Simd = std::integral_constant<bool, SimdEq<V>::enabled && std::is_same<T, V>::value>;
+
+        const V *base = &*first;
+        return findContiguous(base + begin, base + end, value, Simd()) - base;
+    }
+
+    template <typename It, typename T>
+    std::size_t findInChunk(It first, std::size_t begin, std::size_t end, const T &value,
+                            std::false_type)
+    {
+        return std::find(first + begin, first + end, value) - first;
+    }
+
+    template <typename It, typename T>
+    It parallelFind(ThreadPool &pool, It first, It last, const T &value, std::size_t chunk,
+                    std::random_access_iterator_tag)
+    {
+        const std::size_t n = last - first;
+        using Contiguous = std::integral_constant<bool, IsContiguous<It>::value>;
+
+        if (n <= chunk)
+            return first + (n ? findInChunk(first, 0, n, value, Contiguous()) : 0);
+
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> found{n};
+
+        auto search = [&]
+        {
+            for (;;)
+            {
+                std::size_t begin = next.fetch_add(chunk, std::memory_order_relaxed);
+                if (begin >= found.load(std::memory_order_relaxed)) // covers begin >= n
+                    return;
+
+                std::size_t end = std::min(begin + chunk, n);
+                std::size_t hit = findInChunk(first, begin, end, value, Contiguous());
+                if (hit != end)
+                {
+                    std::size_t best = found.load(std::memory_order_relaxed);
+                    while (hit < best && !found.compare_exchange_weak(best, hit))
+                        ;
+                    return;
+                }
+            }
+        };
+
+        std::vector<std::future<void>> done;
+        done.reserve(pool.size());
+        for (unsigned i = 0; i != pool.size(); ++i)
+            done.push_back(pool.submit(search));
+        search();
+        for (auto &f : done)
+            f.get();
+
+        return first + found.load();
+    }
+
+    template <typename It, typename T>
+    It parallelFind(ThreadPool &, It first, It last, const T &value, std::size_t,
+                    std::input_iterator_tag)
+    {
+        return std::find(first, last, value);
+    }
+}
+
+template <typename It, typename T>
+It parallelFind(ThreadPool &pool, It first, It last, const T &value,
+                std::size_t chunk = std::size_t(1) << 16)
+{
+    return detail::parallelFind(pool, first, last, value, chunk,
+                                typename std::iterator_traits<It>::iterator_category());
+}
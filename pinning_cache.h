@@ -0,0 +1,216 @@
+// Weak-pointer cache with a bounded tier of pinned entries.
+//
+// Item 20's fastLoadWidget caches std::weak_ptrs, so an object stays cached
+// only while somebody outside holds it: as soon as the last user lets go of
+// a hot Widget it's freed, and the next request loads it all over again.
+// PinningCache<Key, T> adds a second tier: up to `pinned` of the most
+// recently used objects are also held by a std::shared_ptr, so they stay
+// loaded when nobody else wants them for a moment.
+//
+// Pinned entries are replaced by CLOCK (second chance). A hit on a pinned
+// entry only sets its referenced bit; pinning a new one moves a hand round
+// the ring, clearing bits, until it finds an unreferenced entry to push out.
+// Touches are O(1), and so are evictions, amortized over the sweep. Keys are
+// spread over shards, each with its own mutex, map and ring, and the loader
+// runs, and evicted objects are freed, outside the lock. Two threads that
+// miss the same key may both load it; the first to finish wins.
+//
+// The loader returns null for a key that doesn't exist; null isn't cached.
+// With pinned == 0 this is the plain weak_ptr cache of Item 20. Built as
+// C++17, the shards' maps take their memory from the memory resource given
+// to the constructor.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "flat_hash_map.h"
+
+struct PinningCacheStats
+{
+    std::uint64_t hits = 0;       // found alive in the cache
+    std::uint64_t pinnedHits = 0; // of which found in the pinned tier
+    std::uint64_t loads = 0;      // misses, handed to the loader
+};
+
+template <typename Key, typename T, typename Hash = FlatHash<Key>>
+class PinningCache
+{
+public:
+    using Pointer = std::shared_ptr<const T>;
+    using Loader = std::function<Pointer(const Key &)>;
+
+    // pinned is the capacity of the pinned tier, split evenly over
+    // 2^shardBits shards
+#if defined(FLAT_HASH_PMR)
+    PinningCache(Loader loader, std::size_t pinned, unsigned shardBits = 4,
+                 std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+#else
+    PinningCache(Loader loader, std::size_t pinned, unsigned shardBits = 4)
+#endif
+        : loader(std::move(loader)), shardBits(shardBits), shards(new Shard[std::size_t(1) << shardBits])
+    {
+        std::size_t perShard = (pinned + (std::size_t(1) << shardBits) - 1) >> shardBits;
+        for (std::size_t i = 0; i != shardCount(); ++i)
+        {
+            shards[i].ring.resize(perShard);
+#if defined(FLAT_HASH_PMR)
+            shards[i].entries = Map(resource);
+#endif
+        }
+    }
+
+    PinningCache(const PinningCache &) = delete;
+    PinningCache &operator=(const PinningCache &) = delete;
+
+    Pointer get(const Key &key)
+    {
+        Shard &s = shardOf(key);
+        Pointer evicted; // freed after the lock is released
+        {
+            std::lock_guard<std::mutex> lock(s.m);
+            auto it = s.entries.find(key);
+            if (it != s.entries.end())
+            {
+                Entry &e = it->second;
+                if (e.pin != kUnpinned)
+                {
+                    ++s.stats.hits;
+                    ++s.stats.pinnedHits;
+                    Pin &p = s.ring[e.pin];
+                    p.referenced = true;
+                    return p.object;
+                }
+                if (Pointer object = e.object.lock())
+                {
+                    ++s.stats.hits;
+                    evicted = pin(s, it, object);
+                    return object;
+                }
+            }
+            ++s.stats.loads;
+        }
+
+        Pointer object = loader(key);
+        if (!object)
+            return object;
+
+        std::lock_guard<std::mutex> lock(s.m);
+        auto it = s.entries.try_emplace(key).first;
+        if (Pointer winner = it->second.object.lock()) // loaded meanwhile by another thread
+            return winner;
+        it->second.object = object;
+        evicted = pin(s, it, object);
+        return object;
+    }
+
+    PinningCacheStats stats() const
+    {
+        PinningCacheStats total;
+        for (std::size_t i = 0; i != shardCount(); ++i)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].m);
+            total.hits += shards[i].stats.hits;
+            total.pinnedHits += shards[i].stats.pinnedHits;
+            total.loads += shards[i].stats.loads;
+        }
+        return total;
+    }
+
+    // calls f(key, object) for every pinned entry, e.g. to save the hot set;
+    // each shard is locked only while its pins are copied out
+    template <typename F>
+    void forEachPinned(F f) const
+    {
+        std::vector<std::pair<Key, Pointer>> pins;
+        for (std::size_t i = 0; i != shardCount(); ++i)
+        {
+            pins.clear();
+            {
+                std::lock_guard<std::mutex> lock(shards[i].m);
+                for (const Pin &p : shards[i].ring)
+                    if (p.object)
+                        pins.emplace_back(p.key, p.object);
+            }
+            for (const auto &p : pins)
+                f(p.first, p.second);
+        }
+    }
+
+private:
+    static constexpr std::uint32_t kUnpinned = ~std::uint32_t(0);
+
+    struct Entry
+    {
+        std::weak_ptr<const T> object;
+        std::uint32_t pin = kUnpinned; // index into the shard's ring
+    };
+
+    struct Pin
+    {
+        Key key;
+        Pointer object;
+        bool referenced = false;
+    };
+
+    using Map = FlatHashMap<Key, Entry, Hash>; // erase moves nothing, so iterators survive it
+
+    struct Shard
+    {
+        mutable std::mutex m;
+        Map entries;
+        std::vector<Pin> ring;
+        std::size_t hand = 0;
+        PinningCacheStats stats;
+        char padding[64]; // shards are locked by different threads
+    };
+
+    std::size_t shardCount() const noexcept { return std::size_t(1) << shardBits; }
+
+    Shard &shardOf(const Key &key) const noexcept
+    {
+        if (shardBits == 0)
+            return shards[0];
+        // the map hashes these keys too: take the shard from the top bits
+        std::uint64_t h = static_cast<std::uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull;
+        return shards[h >> (64 - shardBits)];
+    }
+
+    // pins object in place of the first unreferenced entry under the hand,
+    // and returns the object it pushed out
+    static Pointer pin(Shard &s, typename Map::iterator it, const Pointer &object)
+    {
+        if (s.ring.empty())
+            return nullptr;
+        while (s.ring[s.hand].referenced)
+        {
+            s.ring[s.hand].referenced = false;
+            s.hand = s.hand + 1 == s.ring.size() ? 0 : s.hand + 1;
+        }
+        Pin &p = s.ring[s.hand];
+        Pointer evicted = std::move(p.object);
+        if (evicted)
+        {
+            auto old = s.entries.find(p.key);
+            old->second.pin = kUnpinned;
+            // nobody else holds it, and only this map could hand it out again
+            if (evicted.use_count() == 1)
+                s.entries.erase(old);
+        }
+        p.key = it->first;
+        p.object = object;
+        it->second.pin = static_cast<std::uint32_t>(s.hand);
+        s.hand = s.hand + 1 == s.ring.size() ? 0 : s.hand + 1;
+        return evicted;
+    }
+
+    const Loader loader;
+    const unsigned shardBits;
+    std::unique_ptr<Shard[]> shards;
+};
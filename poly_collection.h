@@ -0,0 +1,119 @@
+// Type-segregated polymorphic collection.
+//
+// Instead of a vector of pointers to objects scattered over the heap, every
+// concrete type gets its own contiguous std::vector ("segment"). Visiting runs
+// one tight loop per segment with the static type known, so as long as the
+// concrete types are final the compiler resolves virtual calls statically.
+//
+// Disposer is called with a Base* for every element right before it's
+// destroyed, which keeps custom-deleter side effects (logging, say) intact.
+
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct NoDisposer
+{
+    template <typename T>
+    void operator()(const T *) const noexcept
+    {
+    }
+};
+
+template <typename Base, typename Disposer, typename... Types>
+class PolyCollection
+{
+    static_assert(std::is_polymorphic<Base>::value, "Base must be polymorphic");
+
+public:
+    PolyCollection() = default;
+    explicit PolyCollection(Disposer d) : disposer(std::move(d)) {}
+
+    PolyCollection(const PolyCollection &) = delete;
+    PolyCollection &operator=(const PolyCollection &) = delete;
+    PolyCollection(PolyCollection &&) = default;
+
+    ~PolyCollection() { clear(); }
+
+    template <typename T, typename... Ts>
+    T &emplace(Ts &&...params)
+    {
+        static_assert(std::is_base_of<Base, T>::value && std::is_final<T>::value,
+                      "segments hold final classes derived from Base");
+
+        auto &seg = segment<T>();
+        seg.emplace_back(std::forward<Ts>(params)...);
+        return seg.back();
+    }
+
+    template <typename T>
+    std::vector<T> &segment() noexcept
+    {
+        return std::get<std::vector<T>>(segments);
+    }
+
+    template <typename T>
+    const std::vector<T> &segment() const noexcept
+    {
+        return std::get<std::vector<T>>(segments);
+    }
+
+    // f(segment) once per concrete type
+    template <typename F>
+    void forEachSegment(F &&f)
+    {
+        using expand = int[];
+        (void)expand{0, (f(segment<Types>()), 0)...};
+    }
+
+    template <typename F>
+    void forEachSegment(F &&f) const
+    {
+        using expand = int[];
+        (void)expand{0, (f(segment<Types>()), 0)...};
+    }
+
+    // f(element) for every element, with the element's static type
+    template <typename F>
+    void forEach(F &&f)
+    {
+        forEachSegment([&](auto &seg)
+                       {
+            for (auto &x : seg)
+                f(x); });
+    }
+
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        forEachSegment([&](const auto &seg)
+                       {
+            for (const auto &x : seg)
+                f(x); });
+    }
+
+    std::size_t size() const noexcept
+    {
+        std::size_t n = 0;
+        forEachSegment([&](const auto &seg)
+                       { n += seg.size(); });
+        return n;
+    }
+
+    void clear()
+    {
+        forEachSegment([this](auto &seg)
+                       {
+            for (const auto &x : seg)
+                disposer(static_cast<const Base *>(&x));
+            seg.clear(); });
+    }
+
+private:
+    std::tuple<std::vector<Types>...> segments;
+    Disposer disposer;
+};
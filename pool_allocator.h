@@ -0,0 +1,293 @@
+// Thread-caching, size-class pool allocator.
+//
+// Every thread owns a ThreadCache with one free list per size class, so the
+// common allocate/free pair never takes a lock. Each block remembers the cache
+// that carved it; a block freed on another thread is pushed onto the owner's
+// lock-free "remote" list and the owner pulls those back in the next time its
+// local list for that class runs dry.
+//
+// PoolAllocator<T> plugs the pool into std::allocate_shared (and anything
+// else that takes a standard allocator); allocate_unique is the matching
+// std::unique_ptr factory, which the Standard Library doesn't provide.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pool
+{
+    namespace detail
+    {
+        constexpr std::size_t kAlignment = alignof(std::max_align_t);
+        constexpr std::size_t kNumClasses = 8; // 16, 32, ..., 2048 bytes
+        constexpr std::size_t kMinClassSize = 16;
+        constexpr std::size_t kMaxClassSize = kMinClassSize << (kNumClasses - 1);
+        constexpr std::size_t kChunkSize = 64 * 1024;
+        constexpr std::uint32_t kLargeClass = kNumClasses; // bypasses the pool
+
+        struct ThreadCache;
+
+        // sits in front of every payload; padded so the payload keeps
+        // max_align_t alignment
+        struct alignas(kAlignment) BlockHeader
+        {
+            ThreadCache *owner;
+            std::uint32_t sizeClass;
+        };
+
+        // a free block reuses its payload as the list link
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        inline std::uint32_t sizeClassFor(std::size_t bytes) noexcept
+        {
+            std::uint32_t c = 0;
+            std::size_t classSize = kMinClassSize;
+            while (classSize < bytes)
+            {
+                classSize <<= 1;
+                ++c;
+            }
+            return c;
+        }
+
+        struct ThreadCache
+        {
+            FreeBlock *local[kNumClasses]{};
+            std::atomic<FreeBlock *> remote[kNumClasses]{};
+            std::vector<void *> chunks;
+
+            ~ThreadCache()
+            {
+                for (void *chunk : chunks)
+                    ::operator delete(chunk);
+            }
+
+            void *allocate(std::uint32_t c)
+            {
+                if (!local[c])
+                    refill(c);
+
+                FreeBlock *block = local[c];
+                local[c] = block->next;
+                return block;
+            }
+
+            void deallocateLocal(std::uint32_t c, void *p) noexcept
+            {
+                auto block = static_cast<FreeBlock *>(p);
+                block->next = local[c];
+                local[c] = block;
+            }
+
+            // called from any thread other than the owner
+            void deallocateRemote(std::uint32_t c, void *p) noexcept
+            {
+                auto block = static_cast<FreeBlock *>(p);
+                block->next = remote[c].load(std::memory_order_relaxed);
+                while (!remote[c].compare_exchange_weak(block->next, block,
+                                                        std::memory_order_release,
+                                                        std::memory_order_relaxed))
+                {
+                }
+            }
+
+        private:
+            void refill(std::uint32_t c)
+            {
+                // blocks returned by other threads come first; taking the
+                // whole list at once sidesteps the ABA problem of popping
+                local[c] = remote[c].exchange(nullptr, std::memory_order_acquire);
+                if (local[c])
+                    return;
+
+                const std::size_t stride = sizeof(BlockHeader) + (kMinClassSize << c);
+                char *chunk = static_cast<char *>(::operator new(kChunkSize));
+                chunks.push_back(chunk);
+
+                for (std::size_t off = 0; off + stride <= kChunkSize; off += stride)
+                {
+                    auto header = new (chunk + off) BlockHeader{this, c};
+                    deallocateLocal(c, header + 1);
+                }
+            }
+        };
+
+        // Caches outlive their threads: a block can still be freed long after the
+        // thread that allocated it has exited, so a finished thread only marks its
+        // cache abandoned and the next new thread adopts it (free lists and all).
+        // The registry itself is intentionally leaked, which keeps pooled memory
+        // valid during static destruction.
+        class Registry
+        {
+        public:
+            static Registry &instance()
+            {
+                static Registry *registry = new Registry;
+                return *registry;
+            }
+
+            ThreadCache *acquire()
+            {
+                std::lock_guard<std::mutex> guard(m);
+                if (!abandoned.empty())
+                {
+                    auto cache = abandoned.back();
+                    abandoned.pop_back();
+                    return cache;
+                }
+                caches.push_back(std::make_unique<ThreadCache>());
+                return caches.back().get();
+            }
+
+            void release(ThreadCache *cache)
+            {
+                std::lock_guard<std::mutex> guard(m);
+                abandoned.push_back(cache);
+            }
+
+        private:
+            std::mutex m;
+            std::vector<std::unique_ptr<ThreadCache>> caches;
+            std::vector<ThreadCache *> abandoned;
+        };
+
+        struct CacheHandle
+        {
+            ThreadCache *cache = Registry::instance().acquire();
+            ~CacheHandle() { Registry::instance().release(cache); }
+        };
+
+        inline ThreadCache *localCache()
+        {
+            thread_local CacheHandle handle;
+            return handle.cache;
+        }
+
+        inline void *allocate(std::size_t bytes)
+        {
+            if (bytes > kMaxClassSize)
+            {
+                void *raw = ::operator new(sizeof(BlockHeader) + bytes);
+                auto header = new (raw) BlockHeader{nullptr, kLargeClass};
+                return header + 1;
+            }
+
+            return localCache()->allocate(sizeClassFor(bytes));
+        }
+
+        inline void deallocate(void *p) noexcept
+        {
+            auto header = static_cast<BlockHeader *>(p) - 1;
+            if (header->sizeClass == kLargeClass)
+            {
+                ::operator delete(header);
+                return;
+            }
+
+            ThreadCache *self = localCache();
+            if (header->owner == self)
+                self->deallocateLocal(header->sizeClass, p);
+            else
+                header->owner->deallocateRemote(header->sizeClass, p);
+        }
+    }
+
+    // stateless standard allocator on top of the pool; all instances compare equal
+    template <typename T>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+
+        PoolAllocator() noexcept = default;
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &) noexcept
+        {
+        }
+
+        T *allocate(std::size_t n)
+        {
+            static_assert(alignof(T) <= detail::kAlignment,
+                          "PoolAllocator doesn't support over-aligned types");
+
+            if (n > static_cast<std::size_t>(-1) / sizeof(T))
+                throw std::bad_array_new_length();
+            return static_cast<T *>(detail::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, std::size_t) noexcept
+        {
+            detail::deallocate(p);
+        }
+    };
+
+    template <typename T, typename U>
+    bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept
+    {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept
+    {
+        return false;
+    }
+
+    // deleter that destroys and deallocates through an allocator; derives from
+    // the allocator so a stateless one costs nothing inside std::unique_ptr
+    template <typename Alloc>
+    class AllocDeleter : private Alloc
+    {
+        using Traits = std::allocator_traits<Alloc>;
+
+    public:
+        using pointer = typename Traits::pointer;
+
+        AllocDeleter() = default;
+        explicit AllocDeleter(const Alloc &alloc) noexcept : Alloc(alloc) {}
+
+        void operator()(pointer p)
+        {
+            Alloc &alloc = *this;
+            Traits::destroy(alloc, std::addressof(*p));
+            Traits::deallocate(alloc, p, 1);
+        }
+    };
+
+    template <typename T, typename Alloc>
+    using unique_ptr = std::unique_ptr<
+        T, AllocDeleter<typename std::allocator_traits<Alloc>::template rebind_alloc<T>>>;
+
+    // the std::unique_ptr counterpart of std::allocate_shared
+    template <typename T, typename Alloc, typename... Ts>
+    unique_ptr<T, Alloc> allocate_unique(const Alloc &alloc, Ts &&...params)
+    {
+        using TAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+        using Traits = std::allocator_traits<TAlloc>;
+
+        TAlloc a(alloc);
+        auto p = Traits::allocate(a, 1);
+        try
+        {
+            Traits::construct(a, std::addressof(*p), std::forward<Ts>(params)...);
+        }
+        catch (...)
+        {
+            Traits::deallocate(a, p, 1);
+            throw;
+        }
+        return unique_ptr<T, Alloc>(p, AllocDeleter<TAlloc>(a));
+    }
+}
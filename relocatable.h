@@ -0,0 +1,294 @@
+// Trivial relocation.
+//
+// Moving an object to a new address and destroying the original is, for
+// most types, equivalent to copying its bytes and forgetting the original.
+// is_trivially_relocatable<T> says so for T. It holds for trivially copyable
+// types automatically; other types opt in with a specialization (a class
+// with a vtable but otherwise defaulted members qualifies, and so do
+// unique_ptr, shared_ptr and vector). libstdc++'s std::string does not: a
+// short string points into itself.
+//
+// relocating_vector<T> grows such types with realloc, and once the buffer
+// is big enough to be worth its own mapping, with mremap, which moves pages
+// instead of bytes. Other types grow the std::vector way
+// (std::move_if_noexcept element by element).
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define RELOCATABLE_MREMAP 1
+#endif
+
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T>
+{
+};
+
+template <typename T, typename D>
+struct is_trivially_relocatable<std::unique_ptr<T, D>> : is_trivially_relocatable<D>
+{
+};
+
+template <typename T>
+struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type
+{
+};
+
+template <typename T>
+struct is_trivially_relocatable<std::vector<T>> : std::true_type
+{
+};
+
+template <typename A, typename B>
+struct is_trivially_relocatable<std::pair<A, B>>
+    : std::integral_constant<bool, is_trivially_relocatable<A>::value &&
+                                       is_trivially_relocatable<B>::value>
+{
+};
+
+#if defined(_LIBCPP_VERSION)
+// libc++ keeps short strings inline without pointing at them
+template <typename C, typename Tr>
+struct is_trivially_relocatable<std::basic_string<C, Tr>> : std::true_type
+{
+};
+#endif
+
+template <typename T>
+class relocating_vector
+{
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types not supported");
+
+    using Relocatable = is_trivially_relocatable<T>;
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    // buffers at least this big get a mapping of their own
+    static constexpr std::size_t kMapThreshold = std::size_t(1) << 20;
+
+    relocating_vector() noexcept = default;
+
+    relocating_vector(const relocating_vector &rhs)
+    {
+        reserve(rhs.count);
+        for (const auto &x : rhs)
+            emplace_back(x);
+    }
+
+    relocating_vector(relocating_vector &&rhs) noexcept { swap(rhs); }
+
+    relocating_vector &operator=(relocating_vector rhs) noexcept
+    {
+        swap(rhs);
+        return *this;
+    }
+
+    ~relocating_vector()
+    {
+        clear();
+        release(ptr, bytes, mapped);
+    }
+
+    void swap(relocating_vector &rhs) noexcept
+    {
+        std::swap(ptr, rhs.ptr);
+        std::swap(count, rhs.count);
+        std::swap(cap, rhs.cap);
+        std::swap(bytes, rhs.bytes);
+        std::swap(mapped, rhs.mapped);
+    }
+
+    size_type size() const noexcept { return count; }
+    size_type capacity() const noexcept { return cap; }
+    bool empty() const noexcept { return count == 0; }
+
+    T *data() noexcept { return ptr; }
+    const T *data() const noexcept { return ptr; }
+    iterator begin() noexcept { return ptr; }
+    iterator end() noexcept { return ptr + count; }
+    const_iterator begin() const noexcept { return ptr; }
+    const_iterator end() const noexcept { return ptr + count; }
+
+    T &operator[](size_type i) noexcept { return ptr[i]; }
+    const T &operator[](size_type i) const noexcept { return ptr[i]; }
+    T &back() noexcept { return ptr[count - 1]; }
+
+    void reserve(size_type n)
+    {
+        if (n > cap)
+            grow(n, Relocatable());
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+    template <typename... Ts>
+    T &emplace_back(Ts &&...params)
+    {
+        if (count == cap)
+        {
+            // params may refer to an element that is about to move
+            T value(std::forward<Ts>(params)...);
+            grow(std::max<size_type>(2 * cap, 8), Relocatable());
+            new (ptr + count) T(std::move(value));
+        }
+        else
+            new (ptr + count) T(std::forward<Ts>(params)...);
+        return ptr[count++];
+    }
+
+    void pop_back() noexcept { ptr[--count].~T(); }
+
+    void clear() noexcept
+    {
+        for (size_type i = 0; i != count; ++i)
+            ptr[i].~T();
+        count = 0;
+    }
+
+private:
+    static std::size_t pageRound(std::size_t n) noexcept
+    {
+#if defined(RELOCATABLE_MREMAP)
+        static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        return (n + page - 1) / page * page;
+#else
+        return n;
+#endif
+    }
+
+    static std::size_t bytesFor(size_type n)
+    {
+        if (n > std::size_t(-1) / 2 / sizeof(T))
+            throw std::bad_alloc();
+        std::size_t b = n * sizeof(T);
+        return b >= kMapThreshold ? pageRound(b) : b;
+    }
+
+    static void *acquire(std::size_t b, bool &isMapped)
+    {
+#if defined(RELOCATABLE_MREMAP)
+        if (b >= kMapThreshold)
+        {
+            void *p = ::mmap(nullptr, b, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            isMapped = true;
+            return p;
+        }
+#endif
+        void *p = std::malloc(b);
+        if (!p)
+            throw std::bad_alloc();
+        isMapped = false;
+        return p;
+    }
+
+    static void release(void *p, std::size_t b, bool isMapped) noexcept
+    {
+#if defined(RELOCATABLE_MREMAP)
+        if (isMapped)
+        {
+            ::munmap(p, b);
+            return;
+        }
+#endif
+        (void)b;
+        (void)isMapped;
+        std::free(p);
+    }
+
+    void adopt(void *p, size_type newCap, std::size_t b, bool isMapped) noexcept
+    {
+        ptr = static_cast<T *>(p);
+        cap = newCap;
+        bytes = b;
+        mapped = isMapped;
+    }
+
+    // bytes can simply follow the buffer wherever it goes
+    void grow(size_type newCap, std::true_type)
+    {
+        std::size_t b = bytesFor(newCap);
+        newCap = b / sizeof(T); // page rounding may leave room for more
+        void *p;
+        bool isMapped;
+
+#if defined(RELOCATABLE_MREMAP)
+        if (mapped)
+        {
+            p = ::mremap(ptr, bytes, b, MREMAP_MAYMOVE);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            adopt(p, newCap, b, true);
+            return;
+        }
+#endif
+        if (b < kMapThreshold)
+        {
+            p = std::realloc(static_cast<void *>(ptr), b);
+            if (!p)
+                throw std::bad_alloc();
+            adopt(p, newCap, b, false);
+            return;
+        }
+
+        // a small heap buffer turning into a mapping
+        p = acquire(b, isMapped);
+        if (count)
+            std::memcpy(p, static_cast<const void *>(ptr), count * sizeof(T));
+        release(ptr, bytes, mapped);
+        adopt(p, newCap, b, isMapped);
+    }
+
+    // the std::vector way
+    void grow(size_type newCap, std::false_type)
+    {
+        std::size_t b = bytesFor(newCap);
+        newCap = b / sizeof(T);
+        bool isMapped;
+        T *fresh = static_cast<T *>(acquire(b, isMapped));
+
+        size_type built = 0;
+        try
+        {
+            for (; built != count; ++built)
+                new (fresh + built) T(std::move_if_noexcept(ptr[built]));
+        }
+        catch (...)
+        {
+            for (size_type i = 0; i != built; ++i)
+                fresh[i].~T();
+            release(fresh, b, isMapped);
+            throw;
+        }
+
+        for (size_type i = 0; i != count; ++i)
+            ptr[i].~T();
+        release(ptr, bytes, mapped);
+        adopt(fresh, newCap, b, isMapped);
+    }
+
+    T *ptr = nullptr;
+    size_type count = 0;
+    size_type cap = 0;
+    std::size_t bytes = 0; // size of the buffer ptr points to
+    bool mapped = false;   // from mmap rather than malloc
+};
@@ -0,0 +1,167 @@
+// Generational slot map: a container that hands out its own keys.
+//
+// insert() stores a value and returns a SlotKey, a slot index and a
+// generation packed in 64 bits. Lookups index an array, with no hashing and
+// no node to chase, and insert and erase are O(1) too. Erasing bumps the
+// slot's generation before the slot is reused, so a key to an erased value
+// is detected as stale instead of finding whatever took its place. The
+// values themselves sit contiguously in a vector, in no particular order,
+// so iterating over them is a plain array walk.
+//
+// Erase moves the last value into the hole, so pointers and iterators to
+// values are invalidated by erase as by insert; keys never are. A slot's
+// generation is odd while it holds a value, and a 32-bit count, so a key
+// could only be mistaken for a new one after the same slot had been reused
+// two billion times.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+struct SlotKey
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    std::uint64_t packed() const noexcept { return std::uint64_t(generation) << 32 | index; }
+
+    static SlotKey unpack(std::uint64_t packed) noexcept
+    {
+        return SlotKey{static_cast<std::uint32_t>(packed), static_cast<std::uint32_t>(packed >> 32)};
+    }
+
+    friend bool operator==(SlotKey a, SlotKey b) noexcept
+    {
+        return a.index == b.index && a.generation == b.generation;
+    }
+    friend bool operator!=(SlotKey a, SlotKey b) noexcept { return !(a == b); }
+};
+
+template <typename T>
+class SlotMap
+{
+public:
+    using Key = SlotKey;
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    template <typename... Ts>
+    Key emplace(Ts &&...params)
+    {
+        if (freeHead == kNone)
+        {
+            if (slots.size() == kNone)
+                throw std::length_error("SlotMap is full");
+            slots.push_back(Slot{0, kNone});
+            freeHead = static_cast<std::uint32_t>(slots.size() - 1);
+        }
+        // nothing is taken off the free list until the value is in
+        std::uint32_t index = freeHead;
+        owners.push_back(index);
+        try
+        {
+            values.emplace_back(std::forward<Ts>(params)...);
+        }
+        catch (...)
+        {
+            owners.pop_back();
+            throw;
+        }
+        Slot &slot = slots[index];
+        freeHead = slot.index;
+        ++slot.generation;
+        slot.index = static_cast<std::uint32_t>(values.size() - 1);
+        return Key{index, slot.generation};
+    }
+
+    Key insert(const T &value) { return emplace(value); }
+    Key insert(T &&value) { return emplace(std::move(value)); }
+
+    // null if key was erased, or never came from this map
+    T *find(Key key) noexcept
+    {
+        // an even generation is a free slot's
+        if (key.index >= slots.size() || slots[key.index].generation != key.generation ||
+            (key.generation & 1) == 0)
+            return nullptr;
+        return &values[slots[key.index].index];
+    }
+
+    const T *find(Key key) const noexcept { return const_cast<SlotMap *>(this)->find(key); }
+
+    bool contains(Key key) const noexcept { return find(key) != nullptr; }
+
+    // false if key was already stale
+    bool erase(Key key)
+    {
+        if (!contains(key))
+            return false;
+        Slot &slot = slots[key.index];
+        std::uint32_t hole = slot.index;
+        if (hole + std::size_t(1) != values.size())
+        {
+            values[hole] = std::move(values.back());
+            owners[hole] = owners.back();
+            slots[owners[hole]].index = hole;
+        }
+        values.pop_back();
+        owners.pop_back();
+
+        ++slot.generation;
+        slot.index = freeHead;
+        freeHead = key.index;
+        return true;
+    }
+
+    // the key of the value at position i of the iteration order
+    Key keyAt(std::size_t i) const noexcept
+    {
+        return Key{owners[i], slots[owners[i]].generation};
+    }
+
+    std::size_t size() const noexcept { return values.size(); }
+    bool empty() const noexcept { return values.empty(); }
+
+    void reserve(std::size_t n)
+    {
+        values.reserve(n);
+        owners.reserve(n);
+        slots.reserve(n);
+    }
+
+    // erases everything; keys issued so far all become stale
+    void clear() noexcept
+    {
+        for (std::uint32_t index : owners)
+        {
+            ++slots[index].generation;
+            slots[index].index = freeHead;
+            freeHead = index;
+        }
+        values.clear();
+        owners.clear();
+    }
+
+    iterator begin() noexcept { return values.begin(); }
+    iterator end() noexcept { return values.end(); }
+    const_iterator begin() const noexcept { return values.begin(); }
+    const_iterator end() const noexcept { return values.end(); }
+
+private:
+    static constexpr std::uint32_t kNone = ~std::uint32_t(0);
+
+    struct Slot
+    {
+        std::uint32_t generation;
+        std::uint32_t index; // into values when occupied, else the next free slot
+    };
+
+    std::vector<T> values;
+    std::vector<std::uint32_t> owners; // the slot of each value
+    std::vector<Slot> slots;
+    std::uint32_t freeHead = kNone;
+};
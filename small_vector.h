@@ -0,0 +1,260 @@
+// Vector with inline capacity.
+//
+// small_vector<T, N> keeps up to N elements inside the object itself and
+// only goes to the heap beyond that. When it does grow, elements get to the
+// new buffer the cheapest safe way:
+//
+//  - trivially relocatable types (is_trivially_relocatable, relocatable.h)
+//    are memcpy'd;
+//  - otherwise each element is std::move_if_noexcept'ed, exactly as
+//    std::vector does (Item 14): moved when the move constructor is noexcept
+//    (or there is no copy constructor), copied when a throwing move could
+//    leave both buffers half-done. If a copy throws, the new buffer is torn
+//    down and the vector is left as it was.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "relocatable.h"
+
+template <typename T, std::size_t N>
+class small_vector
+{
+    static_assert(N > 0, "small_vector needs some inline capacity; use std::vector");
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using reference = T &;
+    using const_reference = const T &;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    small_vector() noexcept = default;
+
+    small_vector(std::initializer_list<T> init)
+    {
+        reserve(init.size());
+        for (const auto &x : init)
+            emplace_back(x);
+    }
+
+    small_vector(const small_vector &rhs)
+    {
+        reserve(rhs.size());
+        for (const auto &x : rhs)
+            emplace_back(x);
+    }
+
+    small_vector(small_vector &&rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        takeFrom(rhs);
+    }
+
+    small_vector &operator=(const small_vector &rhs)
+    {
+        if (this != &rhs)
+        {
+            small_vector copy(rhs);
+            clear();
+            takeFrom(copy);
+        }
+        return *this;
+    }
+
+    small_vector &operator=(small_vector &&rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        if (this != &rhs)
+        {
+            clear();
+            takeFrom(rhs);
+        }
+        return *this;
+    }
+
+    ~small_vector()
+    {
+        clear();
+        freeHeap();
+    }
+
+    size_type size() const noexcept { return count; }
+    size_type capacity() const noexcept { return cap; }
+    bool empty() const noexcept { return count == 0; }
+    bool isInline() const noexcept { return ptr == inlineData(); }
+
+    T *data() noexcept { return ptr; }
+    const T *data() const noexcept { return ptr; }
+
+    iterator begin() noexcept { return ptr; }
+    iterator end() noexcept { return ptr + count; }
+    const_iterator begin() const noexcept { return ptr; }
+    const_iterator end() const noexcept { return ptr + count; }
+
+    T &operator[](size_type i) noexcept { return ptr[i]; }
+    const T &operator[](size_type i) const noexcept { return ptr[i]; }
+    T &back() noexcept { return ptr[count - 1]; }
+    const T &back() const noexcept { return ptr[count - 1]; }
+
+    void reserve(size_type n)
+    {
+        if (n > cap)
+            reallocate(n);
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+    template <typename... Ts>
+    T &emplace_back(Ts &&...params)
+    {
+        if (count < cap)
+        {
+            new (ptr + count) T(std::forward<Ts>(params)...);
+            return ptr[count++];
+        }
+
+        // build the new element in the new buffer first: params may refer
+        // to an element of the old one
+        size_type newCap = std::max(2 * cap, count + 1);
+        T *fresh = allocate(newCap);
+        try
+        {
+            new (fresh + count) T(std::forward<Ts>(params)...);
+        }
+        catch (...)
+        {
+            deallocate(fresh, newCap);
+            throw;
+        }
+        try
+        {
+            relocate(ptr, count, fresh);
+        }
+        catch (...)
+        {
+            fresh[count].~T();
+            deallocate(fresh, newCap);
+            throw;
+        }
+        adopt(fresh, newCap);
+        return ptr[count++];
+    }
+
+    void pop_back() noexcept { ptr[--count].~T(); }
+
+    void clear() noexcept
+    {
+        for (size_type i = 0; i != count; ++i)
+            ptr[i].~T();
+        count = 0;
+    }
+
+private:
+    T *inlineData() noexcept { return reinterpret_cast<T *>(&buffer); }
+    const T *inlineData() const noexcept { return reinterpret_cast<const T *>(&buffer); }
+
+    static T *allocate(size_type n)
+    {
+        if (n > std::size_t(-1) / sizeof(T))
+            throw std::length_error("small_vector: too large");
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    static void deallocate(T *p, size_type) noexcept { ::operator delete(p); }
+
+    void freeHeap() noexcept
+    {
+        if (!isInline())
+            deallocate(ptr, cap);
+    }
+
+    // the old elements are gone (relocated) when this is called
+    void adopt(T *fresh, size_type newCap) noexcept
+    {
+        freeHeap();
+        ptr = fresh;
+        cap = newCap;
+    }
+
+    void reallocate(size_type newCap)
+    {
+        T *fresh = allocate(newCap);
+        try
+        {
+            relocate(ptr, count, fresh);
+        }
+        catch (...)
+        {
+            deallocate(fresh, newCap);
+            throw;
+        }
+        adopt(fresh, newCap);
+    }
+
+    // moves n elements from src to raw memory at dst and destroys the
+    // originals; if that throws, src is untouched and dst holds nothing
+    static void relocate(T *src, size_type n, T *dst)
+    {
+        relocate(src, n, dst, is_trivially_relocatable<T>());
+    }
+
+    static void relocate(T *src, size_type n, T *dst, std::true_type) noexcept
+    {
+        if (n)
+            std::memcpy(static_cast<void *>(dst), static_cast<const void *>(src), n * sizeof(T));
+    }
+
+    static void relocate(T *src, size_type n, T *dst, std::false_type)
+    {
+        size_type built = 0;
+        try
+        {
+            for (; built != n; ++built)
+                new (dst + built) T(std::move_if_noexcept(src[built]));
+        }
+        catch (...)
+        {
+            for (size_type i = 0; i != built; ++i)
+                dst[i].~T();
+            throw;
+        }
+        for (size_type i = 0; i != n; ++i)
+            src[i].~T();
+    }
+
+    // requires *this to be empty; leaves rhs empty
+    void takeFrom(small_vector &rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        if (!rhs.isInline())
+        {
+            freeHeap();
+            ptr = rhs.ptr;
+            cap = rhs.cap;
+            count = rhs.count;
+            rhs.ptr = rhs.inlineData();
+            rhs.cap = N;
+            rhs.count = 0;
+            return;
+        }
+
+        // rhs's elements live inside rhs: they have to be moved one by one
+        // (we are empty, and the inline capacity is enough for them)
+        for (; count != rhs.count; ++count)
+            new (ptr + count) T(std::move(rhs.ptr[count]));
+        rhs.clear();
+    }
+
+    T *ptr = inlineData();
+    size_type count = 0;
+    size_type cap = N;
+    std::aligned_storage_t<sizeof(T) * N, alignof(T)> buffer;
+};
@@ -0,0 +1,235 @@
+// Static dispatch over a closed set of types.
+//
+// Variant<Ts...> stores one of Ts inline and visit() calls a function object
+// with the stored object's static type, so a call such as
+// x.T::doWork() inside the visitor is a direct (and inlinable) call instead
+// of a trip through the vtable. C++14 has no std::variant; this one is just
+// enough for that: no empty state, no converting assignment.
+//
+// TypeSortedBatch<Base, Ts...> sorts a heterogeneous batch of Base pointers
+// by dynamic type once; forEach() then runs one tight loop per type, again
+// with the static type known.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace detail
+{
+    template <typename T, typename... Ts>
+    struct IndexOf;
+
+    template <typename T, typename... Ts>
+    struct IndexOf<T, T, Ts...> : std::integral_constant<std::size_t, 0>
+    {
+    };
+
+    template <typename T, typename U, typename... Ts>
+    struct IndexOf<T, U, Ts...>
+        : std::integral_constant<std::size_t, 1 + IndexOf<T, Ts...>::value>
+    {
+    };
+
+    template <typename T, typename... Ts>
+    struct Contains : std::false_type
+    {
+    };
+
+    template <typename T, typename U, typename... Ts>
+    struct Contains<T, U, Ts...>
+        : std::integral_constant<bool, std::is_same<T, U>::value || Contains<T, Ts...>::value>
+    {
+    };
+
+    template <typename... Ts>
+    struct AllNothrowMovable : std::true_type
+    {
+    };
+
+    template <typename T, typename... Ts>
+    struct AllNothrowMovable<T, Ts...>
+        : std::integral_constant<bool, std::is_nothrow_move_constructible<T>::value &&
+                                           std::is_nothrow_move_assignable<T>::value &&
+                                           AllNothrowMovable<Ts...>::value>
+    {
+    };
+}
+
+template <typename... Ts>
+class Variant
+{
+    static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 256, "1 to 255 alternatives");
+
+    template <std::size_t I>
+    using TypeAt = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+public:
+    template <
+        typename T,
+        typename = std::enable_if_t<detail::Contains<std::decay_t<T>, Ts...>::value>>
+    Variant(T &&value) : idx(detail::IndexOf<std::decay_t<T>, Ts...>::value)
+    {
+        new (&storage) std::decay_t<T>(std::forward<T>(value));
+    }
+
+    Variant(const Variant &rhs) : idx(rhs.idx)
+    {
+        rhs.visit([this](const auto &x)
+                  { new (&storage) std::decay_t<decltype(x)>(x); });
+    }
+
+    Variant(Variant &&rhs) noexcept(detail::AllNothrowMovable<Ts...>::value) : idx(rhs.idx)
+    {
+        rhs.visit([this](auto &x)
+                  { new (&storage) std::decay_t<decltype(x)>(std::move(x)); });
+    }
+
+    Variant &operator=(const Variant &rhs)
+    {
+        if (this != &rhs)
+        {
+            Variant copy(rhs); // strong guarantee, as long as moves don't throw
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    // the same alternative is move-assigned, and keeps its own guarantee;
+    // a different one is destroyed first, and as there's no empty state to
+    // fall back on, a move constructor that throws then terminates
+    Variant &operator=(Variant &&rhs) noexcept(detail::AllNothrowMovable<Ts...>::value)
+    {
+        if (this == &rhs)
+            return *this;
+        if (idx == rhs.idx)
+            rhs.visit([this](auto &x)
+                      {
+                using T = std::decay_t<decltype(x)>;
+                *reinterpret_cast<T *>(&storage) = std::move(x); });
+        else
+            replaceWith(rhs);
+        return *this;
+    }
+
+    ~Variant() { destroy(); }
+
+    std::size_t index() const noexcept { return idx; }
+
+    // f(T&) for the stored T; the chain of index tests below is turned into
+    // a jump table (or a couple of compares) by the optimizer, and every f
+    // call is direct
+    template <typename F>
+    decltype(auto) visit(F &&f)
+    {
+        return visitAt<0>(f, *this, std::integral_constant<bool, (sizeof...(Ts) > 1)>());
+    }
+
+    template <typename F>
+    decltype(auto) visit(F &&f) const
+    {
+        return visitAt<0>(f, *this, std::integral_constant<bool, (sizeof...(Ts) > 1)>());
+    }
+
+private:
+    template <std::size_t I, typename F, typename Self>
+    static decltype(auto) visitAt(F &f, Self &self, std::true_type)
+    {
+        if (self.idx == I)
+            return f(self.template get<I>());
+        return visitAt<I + 1>(f, self, std::integral_constant<bool, (I + 2 < sizeof...(Ts))>());
+    }
+
+    // the last alternative: nothing left to test
+    template <std::size_t I, typename F, typename Self>
+    static decltype(auto) visitAt(F &f, Self &self, std::false_type)
+    {
+        return f(self.template get<I>());
+    }
+
+    template <std::size_t I>
+    TypeAt<I> &get() noexcept { return *reinterpret_cast<TypeAt<I> *>(&storage); }
+
+    template <std::size_t I>
+    const TypeAt<I> &get() const noexcept { return *reinterpret_cast<const TypeAt<I> *>(&storage); }
+
+    void replaceWith(Variant &rhs) noexcept
+    {
+        destroy();
+        idx = rhs.idx;
+        rhs.visit([this](auto &x)
+                  { new (&storage) std::decay_t<decltype(x)>(std::move(x)); });
+    }
+
+    void destroy() noexcept
+    {
+        visit([](auto &x)
+              {
+            using T = std::decay_t<decltype(x)>;
+            x.~T(); });
+    }
+
+    std::aligned_union_t<0, Ts...> storage;
+    unsigned char idx;
+};
+
+template <typename Base, typename... Ts>
+class TypeSortedBatch
+{
+public:
+    // objects: any range of (smart) pointers to Base; every dynamic type
+    // must be one of Ts
+    template <typename Range>
+    explicit TypeSortedBatch(const Range &objects)
+    {
+        for (const auto &p : objects)
+            segments[segmentOf(typeid(*p))].push_back(&*p);
+    }
+
+    // f(T&) for every object, one type after the other
+    template <typename F>
+    void forEach(F &&f)
+    {
+        forEachSegment(f, std::index_sequence_for<Ts...>());
+    }
+
+    std::size_t size() const noexcept
+    {
+        std::size_t n = 0;
+        for (const auto &seg : segments)
+            n += seg.size();
+        return n;
+    }
+
+private:
+    static std::size_t segmentOf(const std::type_info &type)
+    {
+        const std::type_info *types[] = {&typeid(Ts)...};
+        for (std::size_t i = 0; i != sizeof...(Ts); ++i)
+            if (*types[i] == type)
+                return i;
+        throw std::invalid_argument("TypeSortedBatch: dynamic type not in the type list");
+    }
+
+    template <typename F, std::size_t... Is>
+    void forEachSegment(F &f, std::index_sequence<Is...>)
+    {
+        using expand = int[];
+        (void)expand{0, (runSegment<Ts>(f, segments[Is]), 0)...};
+    }
+
+    template <typename T, typename F>
+    static void runSegment(F &f, const std::vector<Base *> &seg)
+    {
+        for (Base *p : seg)
+            f(static_cast<T &>(*p));
+    }
+
+    std::vector<Base *> segments[sizeof...(Ts)];
+};
@@ -0,0 +1,201 @@
+// Coroutine task type (C++20).
+//
+// Task<T> is a lazily started coroutine returning T. co_await'ing it starts
+// it and resumes the awaiter, by symmetric transfer, when it finishes; an
+// exception it throws comes out of the co_await. spawn() starts a
+// Task<void> that nobody awaits: its frame destroys itself when it
+// finishes, and an exception escaping it terminates the program.
+//
+// A task's frame is its only allocation. taskFrames() counts the frames
+// alive and their bytes, which is what a suspended task costs.
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "task.h needs C++20 coroutines"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+
+struct TaskFrames
+{
+    std::atomic<std::size_t> alive{0};
+    std::atomic<std::size_t> bytes{0};
+};
+
+inline TaskFrames &taskFrames() noexcept
+{
+    static TaskFrames frames;
+    return frames;
+}
+
+template <typename T = void>
+class Task;
+
+namespace detail
+{
+    struct TaskPromiseBase
+    {
+        // the frame remembers its size, so operator delete can count it
+        static void *operator new(std::size_t size)
+        {
+            auto *p = static_cast<std::size_t *>(::operator new(size + sizeof(std::max_align_t)));
+            *p = size;
+            TaskFrames &f = taskFrames();
+            f.alive.fetch_add(1, std::memory_order_relaxed);
+            f.bytes.fetch_add(size, std::memory_order_relaxed);
+            return reinterpret_cast<char *>(p) + sizeof(std::max_align_t);
+        }
+
+        static void operator delete(void *frame) noexcept
+        {
+            auto *p = reinterpret_cast<std::size_t *>(static_cast<char *>(frame) - sizeof(std::max_align_t));
+            TaskFrames &f = taskFrames();
+            f.alive.fetch_sub(1, std::memory_order_relaxed);
+            f.bytes.fetch_sub(*p, std::memory_order_relaxed);
+            ::operator delete(p);
+        }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+            {
+                TaskPromiseBase &promise = h.promise();
+                if (promise.continuation)
+                    return promise.continuation;
+                if (promise.detached)
+                    h.destroy();
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception() noexcept
+        {
+            if (detached)
+                std::terminate();
+            error = std::current_exception();
+        }
+
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+        bool detached = false;
+    };
+
+    template <typename T>
+    struct TaskPromise : TaskPromiseBase
+    {
+        Task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U &&v)
+        {
+            new (&storage) T(std::forward<U>(v));
+            hasValue = true;
+        }
+
+        T take()
+        {
+            if (error)
+                std::rethrow_exception(error);
+            return std::move(*std::launder(reinterpret_cast<T *>(&storage)));
+        }
+
+        ~TaskPromise()
+        {
+            if (hasValue)
+                std::launder(reinterpret_cast<T *>(&storage))->~T();
+        }
+
+        alignas(T) unsigned char storage[sizeof(T)];
+        bool hasValue = false;
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase
+    {
+        Task<void> get_return_object() noexcept;
+
+        void return_void() noexcept {}
+
+        void take()
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+}
+
+template <typename T>
+class Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle h) noexcept : handle(h) {}
+    Task(Task &&rhs) noexcept : handle(std::exchange(rhs.handle, nullptr)) {}
+    Task &operator=(Task rhs) noexcept
+    {
+        std::swap(handle, rhs.handle);
+        return *this;
+    }
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            Handle handle;
+
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().take(); }
+        };
+        return Awaiter{handle};
+    }
+
+    friend void spawn(Task<void> task);
+
+private:
+    Handle handle;
+};
+
+template <typename T>
+Task<T> detail::TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+// starts task; it runs until its first suspension before spawn returns
+inline void spawn(Task<void> task)
+{
+    auto h = std::exchange(task.handle, nullptr);
+    h.promise().detached = true;
+    h.resume();
+}
@@ -0,0 +1,97 @@
+// Fixed-size thread pool.
+//
+// A single locked queue of InplaceFunction tasks served by `threads` workers.
+// submit() returns a std::future for the task's result; an exception thrown
+// by the task comes out of future::get(). The destructor runs whatever is
+// still queued, then joins the workers.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "inplace_function.h"
+
+class ThreadPool
+{
+public:
+    using Task = InplaceFunction<void(), 32>;
+
+    explicit ThreadPool(unsigned threads = defaultThreads())
+    {
+        workers.reserve(threads);
+        for (unsigned i = 0; i != threads; ++i)
+            workers.emplace_back([this]
+                                 { run(); });
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+
+    unsigned size() const noexcept { return static_cast<unsigned>(workers.size()); }
+
+    static unsigned defaultThreads() noexcept
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    template <typename F>
+    auto submit(F &&f) -> std::future<TaskResult<F>>
+    {
+        using R = TaskResult<F>;
+
+        // the packaged_task keeps f in its shared state, so the queued task
+        // is just a pointer whatever the size of f
+        std::packaged_task<R()> task(std::forward<F>(f));
+        auto result = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m);
+            tasks.emplace_back(std::move(task));
+        }
+        cv.notify_one();
+        return result;
+    }
+
+private:
+    void run()
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [this]
+                        { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Task> tasks;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,189 @@
+// Hierarchical timer wheel for sleeping coroutines (C++20).
+//
+//     co_await wheel.sleepUntil(t);
+//
+// suspends the coroutine until t; run() resumes sleepers as their time comes
+// and returns when none are left. Time is cut into ticks (1 ms unless told
+// otherwise) and sleepers are never woken early, only up to about a tick
+// late. Four levels of 256 slots cover 2^32 ticks: level 0 holds the next
+// 256 ticks one per slot, each higher level 256 times coarser, and a slot
+// of a higher level is redistributed to the levels below when time reaches
+// it. Inserting and waking a sleeper are O(1).
+//
+// The list node lives in the awaiter, which lives in the sleeping
+// coroutine's frame, so a sleeper costs the wheel nothing, and the wheel
+// itself is a fixed 8 KiB however many coroutines sleep on it. A wheel is
+// driven by one thread: the one calling run(), which is also where the
+// sleepers resume.
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "timer_wheel.h needs C++20 coroutines"
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Time = Clock::time_point;
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1))
+        : tick(tick), start(Clock::now())
+    {
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    std::size_t sleepers() const noexcept { return pending; }
+
+    struct Sleeper
+    {
+        bool await_ready() const noexcept { return due <= Clock::now(); }
+
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            handle = h;
+            wheel.insert(this);
+        }
+
+        void await_resume() const noexcept {}
+
+        TimerWheel &wheel;
+        Time due;
+        std::coroutine_handle<> handle;
+        std::uint64_t dueTick = 0;
+        Sleeper *next = nullptr;
+    };
+
+    Sleeper sleepUntil(Time t) noexcept { return Sleeper{*this, t, nullptr}; }
+    Sleeper sleepFor(Clock::duration d) noexcept { return sleepUntil(Clock::now() + d); }
+
+    // resumes sleepers as they come due, until there are none
+    void run()
+    {
+        while (pending)
+        {
+            advanceTo(ticksPassed(Clock::now()));
+            if (pending)
+                std::this_thread::sleep_until(timeOf(nextDueTick()));
+        }
+    }
+
+private:
+    static constexpr unsigned kLevels = 4;
+    static constexpr unsigned kSlotBits = 8;
+    static constexpr std::uint64_t kSlots = 1 << kSlotBits;
+    static constexpr std::uint64_t kSpan = std::uint64_t(1) << (kLevels * kSlotBits);
+
+    // the first tick starting at or after t, so nobody wakes early
+    std::uint64_t tickOf(Time t) const noexcept
+    {
+        if (t <= start)
+            return 0;
+        return static_cast<std::uint64_t>((t - start + tick - Clock::duration(1)) / tick);
+    }
+
+    // the ticks that have fully passed by t: rounding up here would wake
+    // sleepers due later in the current tick
+    std::uint64_t ticksPassed(Time t) const noexcept
+    {
+        if (t <= start)
+            return 0;
+        return static_cast<std::uint64_t>((t - start) / tick);
+    }
+
+    Time timeOf(std::uint64_t t) const noexcept { return start + tick * static_cast<std::int64_t>(t); }
+
+    void insert(Sleeper *s) noexcept
+    {
+        s->dueTick = tickOf(s->due);
+        ++pending;
+        place(s);
+    }
+
+    void place(Sleeper *s) noexcept
+    {
+        if (s->dueTick <= now)
+        {
+            s->next = ready;
+            ready = s;
+            return;
+        }
+        std::uint64_t delta = s->dueTick - now;
+        // beyond the top level: park at its far end, and look again then
+        std::uint64_t tickForSlot = delta < kSpan ? s->dueTick : now + kSpan - 1;
+        unsigned level = 0;
+        while (level + 1 < kLevels && delta >= (std::uint64_t(1) << ((level + 1) * kSlotBits)))
+            ++level;
+        Sleeper *&head = slots[level][(tickForSlot >> (level * kSlotBits)) & (kSlots - 1)];
+        s->next = head;
+        head = s;
+    }
+
+    void advanceTo(std::uint64_t target)
+    {
+        while (now < target)
+        {
+            ++now;
+            // entering a new block of a higher level: spread its slot over
+            // the levels below, coarsest first
+            for (unsigned level = kLevels - 1; level != 0; --level)
+            {
+                std::uint64_t mask = (std::uint64_t(1) << (level * kSlotBits)) - 1;
+                if ((now & mask) != 0)
+                    continue;
+                Sleeper *s = std::exchange(slots[level][(now >> (level * kSlotBits)) & (kSlots - 1)], nullptr);
+                while (s)
+                    place(std::exchange(s, s->next));
+            }
+            wake(std::exchange(slots[0][now & (kSlots - 1)], nullptr));
+        }
+        wake(nullptr);
+    }
+
+    // resumes a list of sleepers; anything due now that they start waiting
+    // for lands on `ready` and is woken in the same pass
+    void wake(Sleeper *s)
+    {
+        do
+        {
+            for (Sleeper *next; s; s = next)
+            {
+                next = s->next; // *s is gone once resumed
+#if defined(__GNUC__)
+                if (next) // in another frame, far away: start the cache miss now
+                    __builtin_prefetch(next);
+#endif
+                --pending;
+                s->handle.resume();
+            }
+        } while ((s = std::exchange(ready, nullptr)));
+    }
+
+    // the next tick with something to do: a due level-0 slot or the next
+    // redistribution of a higher level
+    std::uint64_t nextDueTick() const noexcept
+    {
+        std::uint64_t blockEnd = (now | (kSlots - 1)) + 1;
+        for (std::uint64_t t = now + 1; t != blockEnd; ++t)
+            if (slots[0][t & (kSlots - 1)])
+                return t;
+        return blockEnd;
+    }
+
+    const Clock::duration tick;
+    const Time start;
+    std::uint64_t now = 0; // ticks up to and including this one are done
+    std::size_t pending = 0;
+    Sleeper *ready = nullptr;
+    Sleeper *slots[kLevels][kSlots] = {};
+};
@@ -0,0 +1,298 @@
+// Scoped trace spans, exported as Chrome trace-event JSON.
+//
+//     void load()
+//     {
+//         TRACE_SCOPE("load");   // from here to the end of the scope
+//         ...
+//     }
+//     trace::writeJson("load.trace.json");   // open in Perfetto or chrome://tracing
+//
+// A span costs two reads of the time-stamp counter and one store into a
+// buffer owned by the calling thread: no lock, no allocation except when a
+// 16K-event chunk fills up. Ticks are converted to time only when the trace
+// is written, calibrated against steady_clock over the whole recording.
+// Machines without a TSC read steady_clock directly.
+//
+// Names are stored by pointer, so they must be string literals (or outlive
+// the export). writeJson() and clear() must not race with threads still
+// recording spans. When a thread exits, its spans are kept for the export
+// in memory trimmed to fit them, and clear() frees them for good.
+//
+// With TRACE_DISABLED defined (cmake -DTRACING=OFF), TRACE_SCOPE expands to
+// nothing and writeJson() and clear() do nothing.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define TRACE_RDTSC 1
+#endif
+
+namespace trace
+{
+#if !defined(TRACE_DISABLED)
+    namespace detail
+    {
+        struct Event
+        {
+            const char *name;
+            std::uint64_t begin, end; // ticks
+        };
+
+        struct ThreadBuffer
+        {
+            static constexpr std::size_t kChunkSize = 1 << 14; // events
+
+            explicit ThreadBuffer(unsigned tid) : tid(tid) { grow(); }
+
+            void push(const char *name, std::uint64_t begin, std::uint64_t end)
+            {
+                if (used == kChunkSize)
+                    grow();
+                current[used++] = Event{name, begin, end};
+            }
+
+            void grow()
+            {
+                chunks.emplace_back(new Event[kChunkSize]);
+                current = chunks.back().get();
+                used = 0;
+            }
+
+            // every chunk is full except the last
+            template <typename F>
+            void forEach(F f) const
+            {
+                for (std::size_t c = 0; c != chunks.size(); ++c)
+                {
+                    std::size_t n = c + 1 == chunks.size() ? used : kChunkSize;
+                    for (std::size_t i = 0; i != n; ++i)
+                        f(chunks[c][i]);
+                }
+            }
+
+            void clear()
+            {
+                chunks.resize(1);
+                current = chunks.back().get();
+                used = 0;
+            }
+
+            bool empty() const noexcept { return chunks.size() == 1 && used == 0; }
+
+            // for a finished thread: nothing more will be pushed
+            void shrinkToFit()
+            {
+                std::unique_ptr<Event[]> last(new Event[used]);
+                std::copy(current, current + used, last.get());
+                chunks.back() = std::move(last);
+                current = chunks.back().get();
+                retired = true;
+            }
+
+            const unsigned tid;
+            bool retired = false;
+            Event *current;
+            std::size_t used;
+            std::vector<std::unique_ptr<Event[]>> chunks;
+        };
+
+        inline std::uint64_t steadyNs() noexcept
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        inline std::uint64_t ticks() noexcept
+        {
+#if defined(TRACE_RDTSC)
+            return __rdtsc();
+#else
+            return steadyNs();
+#endif
+        }
+
+        // owns every thread's buffer, so spans outlive their threads
+        struct Registry
+        {
+            Registry() : startTicks(ticks()), startNs(steadyNs()) {}
+
+            ThreadBuffer *add()
+            {
+                std::lock_guard<std::mutex> lock(m);
+                buffers.emplace_back(new ThreadBuffer(++lastTid));
+                return buffers.back().get();
+            }
+
+            // called as b's thread exits: a buffer with no spans is freed
+            void retire(ThreadBuffer *b)
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (b->empty())
+                    erase(b);
+                else
+                    b->shrinkToFit();
+            }
+
+            void erase(ThreadBuffer *b)
+            {
+                buffers.erase(std::find_if(buffers.begin(), buffers.end(),
+                                           [b](const std::unique_ptr<ThreadBuffer> &p)
+                                           { return p.get() == b; }));
+            }
+
+            // ticks per nanosecond, measured since the registry was created
+            double tickRate() const
+            {
+#if defined(TRACE_RDTSC)
+                if (steadyNs() - startNs < 10000000) // too short to be accurate
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                std::uint64_t t = ticks(), ns = steadyNs();
+                return double(t - startTicks) / double(ns - startNs);
+#else
+                return 1;
+#endif
+            }
+
+            std::mutex m;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+            unsigned lastTid = 0;
+            const std::uint64_t startTicks;
+            const std::uint64_t startNs;
+        };
+
+        inline Registry &registry()
+        {
+            static Registry r;
+            return r;
+        }
+
+        // trivially constructible, so reaching it needs no initialization check
+        inline ThreadBuffer *&localBuffer() noexcept
+        {
+            static thread_local ThreadBuffer *buffer = nullptr;
+            return buffer;
+        }
+
+        // hands the thread's buffer back to the registry when the thread exits
+        struct BufferRetirer
+        {
+            ~BufferRetirer()
+            {
+                if (ThreadBuffer *b = localBuffer())
+                    registry().retire(b);
+                localBuffer() = nullptr;
+            }
+        };
+
+        inline ThreadBuffer &buffer()
+        {
+            ThreadBuffer *&b = localBuffer();
+            if (!b)
+            {
+                static thread_local BufferRetirer retirer;
+                b = registry().add();
+            }
+            return *b;
+        }
+
+        inline void writeString(std::FILE *out, const char *s)
+        {
+            std::fputc('"', out);
+            for (; *s; ++s)
+            {
+                unsigned char c = *s;
+                if (c == '"' || c == '\\')
+                    std::fprintf(out, "\\%c", c);
+                else if (c < 0x20)
+                    std::fprintf(out, "\\u%04x", c);
+                else
+                    std::fputc(c, out);
+            }
+            std::fputc('"', out);
+        }
+    }
+
+    class Span
+    {
+    public:
+        explicit Span(const char *name) : buffer(detail::buffer()), name(name), begin(detail::ticks()) {}
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+        ~Span() { buffer.push(name, begin, detail::ticks()); }
+
+    private:
+        detail::ThreadBuffer &buffer;
+        const char *name;
+        std::uint64_t begin;
+    };
+
+    // writes every span recorded so far; false if path can't be written
+    inline bool writeJson(const char *path)
+    {
+        std::FILE *out = std::fopen(path, "w");
+        if (!out)
+            return false;
+
+        detail::Registry &r = detail::registry();
+        const double perTick = 1e-3 / r.tickRate(); // microseconds, as the format wants
+        const int pid = ::getpid();
+
+        std::lock_guard<std::mutex> lock(r.m);
+        std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+        const char *separator = "\n";
+        for (const auto &b : r.buffers)
+            b->forEach([&](const detail::Event &e)
+                       {
+                std::fputs(separator, out);
+                separator = ",\n";
+                std::fputs("{\"ph\":\"X\",\"name\":", out);
+                detail::writeString(out, e.name);
+                std::fprintf(out, ",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", pid, b->tid,
+                             double(e.begin - r.startTicks) * perTick,
+                             double(e.end - e.begin) * perTick); });
+        std::fputs("\n]}\n", out);
+        return std::fclose(out) == 0;
+    }
+
+    // forgets every span recorded so far
+    inline void clear()
+    {
+        detail::Registry &r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.m);
+        r.buffers.erase(std::remove_if(r.buffers.begin(), r.buffers.end(),
+                                       [](const std::unique_ptr<detail::ThreadBuffer> &b)
+                                       { return b->retired; }),
+                        r.buffers.end());
+        for (auto &b : r.buffers)
+            b->clear();
+    }
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) ::trace::Span TRACE_CONCAT(traceSpan_, __LINE__)(name)
+
+#else
+
+    inline bool writeJson(const char *) { return false; }
+    inline void clear() {}
+
+#define TRACE_SCOPE(name) static_cast<void>(0)
+
+#endif
+}
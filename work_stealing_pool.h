@@ -0,0 +1,695 @@
+// Work-stealing thread pool for fork-join parallelism.
+//
+// Each worker owns a Chase-Lev deque: it pushes and pops jobs at the bottom
+// with no locks, and idle workers steal from the top of someone else's.
+// join(a, b) pushes b, runs a, then runs b itself unless a thief got there
+// first, in which case it helps with other jobs until b is done. The job
+// lives in join's stack frame and keeps b in an InplaceFunction, so forking
+// allocates nothing. parallelFor and parallelReduce split their range in
+// halves with join down to `grain` elements.
+//
+// Work from outside the pool goes through a locked queue: submit() returns a
+// TaskFuture, whose get() helps run other jobs when called on a worker
+// instead of blocking it; run() submits and waits, or just calls f when
+// already on a worker. The queue is intrusive: f, its result and the state
+// the TaskFuture waits on share one block, the queue's node, taken from
+// pool_allocator.h's thread-caching pool, so submitting costs no malloc once
+// the pool is warm. (f stays in its own type rather than an InplaceFunction,
+// so it may be of any size.)
+//
+// An idle worker polls for a short while (a few hundred pause and yield
+// rounds), then sleeps on a condition variable until new work arrives, so
+// an idle pool costs no CPU.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "inplace_function.h"
+#include "pool_allocator.h"
+
+class WorkStealingPool;
+
+namespace detail
+{
+    inline void cpuRelax() noexcept
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // a forked half of a join; lives in the joining thread's stack frame
+    struct Job
+    {
+        explicit Job(InplaceFunction<void(), 16> fn) : fn(std::move(fn)) {}
+
+        void run() noexcept
+        {
+            try
+            {
+                fn();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            done.store(true, std::memory_order_release);
+        }
+
+        InplaceFunction<void(), 16> fn;
+        std::exception_ptr error;
+        std::atomic<bool> done{false};
+    };
+
+    // Chase-Lev deque (in the C11 formulation of Le, Pop, Cohen and
+    // Zappa Nardelli) of a fixed capacity; push() fails when it is full
+    class WorkDeque
+    {
+    public:
+        static constexpr std::int64_t kCapacity = 1 << 10;
+
+        // owner only
+        bool push(Job *job) noexcept
+        {
+            std::int64_t b = bottom.load(std::memory_order_relaxed);
+            std::int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= kCapacity)
+                return false;
+            slots[b & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release); // publishes the slot
+            return true;
+        }
+
+        // owner only; the most recently pushed job
+        Job *pop() noexcept
+        {
+            std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = top.load(std::memory_order_relaxed);
+
+            Job *job = nullptr;
+            if (t <= b)
+            {
+                job = slots[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+                if (t == b) // the last one: race the thieves for it
+                {
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed))
+                        job = nullptr;
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            }
+            else
+                bottom.store(b + 1, std::memory_order_relaxed);
+            return job;
+        }
+
+        // any thread; the oldest job, or null if empty or lost a race
+        Job *steal() noexcept
+        {
+            std::int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            Job *job = slots[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+
+        bool empty() const noexcept
+        {
+            return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+        }
+
+    private:
+        // padded apart: thieves hammer top, the owner bottom
+        std::atomic<std::int64_t> top{0};
+        char topPadding[64 - sizeof(std::int64_t)];
+        std::atomic<std::int64_t> bottom{0};
+        char bottomPadding[64 - sizeof(std::int64_t)];
+        std::atomic<Job *> slots[kCapacity];
+    };
+
+    // a submitted task, also the node of the pool's queue; freed by the
+    // last of the pool (once it has run the task) and the TaskFuture
+    struct Submitted
+    {
+        using Run = void (*)(Submitted *);
+        using Destroy = void (*)(Submitted *);
+
+        Submitted(Run run, Destroy destroy) noexcept : runFn(run), destroyFn(destroy) {}
+
+        // runs the task and drops the pool's reference
+        void run() noexcept
+        {
+            runFn(this);
+            release();
+        }
+
+        // called by runFn once the result or the exception is stored
+        void finish()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                ready.store(true, std::memory_order_release);
+            }
+            cv.notify_all();
+        }
+
+        void wait()
+        {
+            if (ready.load(std::memory_order_acquire))
+                return;
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this]
+                    { return ready.load(std::memory_order_relaxed); });
+        }
+
+        void release() noexcept
+        {
+            if (owners.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                destroyFn(this);
+        }
+
+        Run runFn;
+        Destroy destroyFn;
+        Submitted *next = nullptr;
+        std::atomic<bool> ready{false};
+        std::atomic<int> owners{2}; // the pool and the TaskFuture
+        std::exception_ptr error;
+        std::mutex m; // with cv, for threads that block on the result
+        std::condition_variable cv;
+    };
+
+    // where a task's R goes; void and references need no storage
+    template <typename R>
+    struct ResultSlot
+    {
+        ResultSlot() = default;
+        ResultSlot(const ResultSlot &) = delete;
+        ResultSlot &operator=(const ResultSlot &) = delete;
+
+        ~ResultSlot()
+        {
+            if (hasValue)
+                value()->~R();
+        }
+
+        template <typename F>
+        void store(F &f)
+        {
+            new (&storage) R(f());
+            hasValue = true;
+        }
+
+        R take() { return std::move(*value()); }
+
+        R *value() noexcept { return reinterpret_cast<R *>(&storage); }
+
+        typename std::aligned_storage<sizeof(R), alignof(R)>::type storage;
+        bool hasValue = false;
+    };
+
+    template <typename R>
+    struct ResultSlot<R &>
+    {
+        template <typename F>
+        void store(F &f) { value = std::addressof(f()); }
+
+        R &take() noexcept { return *value; }
+
+        R *value = nullptr;
+    };
+
+    template <>
+    struct ResultSlot<void>
+    {
+        template <typename F>
+        void store(F &f) { f(); }
+
+        void take() noexcept {}
+    };
+
+    template <typename R>
+    struct SubmittedResult : Submitted
+    {
+        using Submitted::Submitted;
+
+        ResultSlot<R> result;
+    };
+
+    template <typename R, typename Fn>
+    struct SubmittedTask final : SubmittedResult<R>
+    {
+        template <typename F>
+        explicit SubmittedTask(F &&f) : SubmittedResult<R>(&runImpl, &destroyImpl), fn(std::forward<F>(f))
+        {
+        }
+
+        static void runImpl(Submitted *s)
+        {
+            auto self = static_cast<SubmittedTask *>(s);
+            try
+            {
+                self->result.store(self->fn);
+            }
+            catch (...)
+            {
+                self->error = std::current_exception();
+            }
+            self->finish();
+        }
+
+        static void destroyImpl(Submitted *s)
+        {
+            auto self = static_cast<SubmittedTask *>(s);
+            self->~SubmittedTask();
+            pool::detail::deallocate(self);
+        }
+
+        Fn fn;
+    };
+}
+
+template <typename R>
+class TaskFuture
+{
+public:
+    TaskFuture() noexcept = default;
+
+    TaskFuture(TaskFuture &&rhs) noexcept : task(rhs.task), pool(rhs.pool) { rhs.task = nullptr; }
+
+    TaskFuture &operator=(TaskFuture &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            task = rhs.task;
+            pool = rhs.pool;
+            rhs.task = nullptr;
+        }
+        return *this;
+    }
+
+    ~TaskFuture() { reset(); }
+
+    bool valid() const noexcept { return task != nullptr; }
+    bool ready() const noexcept { return task->ready.load(std::memory_order_acquire); }
+
+    void wait();
+
+    // like std::future::get, once only; valid() is false afterwards
+    R get()
+    {
+        wait();
+        Reset done{*this};
+        if (task->error)
+            std::rethrow_exception(task->error);
+        return task->result.take();
+    }
+
+private:
+    friend class WorkStealingPool;
+
+    struct Reset
+    {
+        TaskFuture &future;
+        ~Reset() { future.reset(); }
+    };
+
+    TaskFuture(detail::SubmittedResult<R> *task, WorkStealingPool *pool) noexcept
+        : task(task), pool(pool)
+    {
+    }
+
+    void reset() noexcept
+    {
+        if (task)
+            task->release();
+        task = nullptr;
+    }
+
+    detail::SubmittedResult<R> *task = nullptr;
+    WorkStealingPool *pool = nullptr;
+};
+
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned threads = defaultThreads())
+    {
+        threads = std::max(threads, 1u);
+        workers.reserve(threads);
+        for (unsigned i = 0; i != threads; ++i)
+            workers.emplace_back(new Worker(i));
+        for (auto &w : workers)
+            w->thread = std::thread([this, &w]
+                                    { workerLoop(*w); });
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // runs whatever was submitted and not yet run, then joins the workers
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+            ++wakeEpoch;
+        }
+        cv.notify_all();
+        for (auto &w : workers)
+            w->thread.join();
+    }
+
+    unsigned size() const noexcept { return static_cast<unsigned>(workers.size()); }
+
+    static unsigned defaultThreads() noexcept
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    // true on this pool's own worker threads
+    bool onWorkerThread() const noexcept { return currentWorker().pool == this; }
+
+    template <typename F>
+    auto submit(F &&f) -> TaskFuture<TaskResult<F>>
+    {
+        using R = TaskResult<F>;
+        using Block = detail::SubmittedTask<R, std::decay_t<F>>;
+        static_assert(alignof(Block) <= pool::detail::kAlignment, "callable over-aligned");
+
+        void *raw = pool::detail::allocate(sizeof(Block));
+        Block *task;
+        try
+        {
+            task = new (raw) Block(std::forward<F>(f));
+        }
+        catch (...)
+        {
+            pool::detail::deallocate(raw);
+            throw;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            (injectedTail ? injectedTail->next : injectedHead) = task;
+            injectedTail = task;
+            injectedCount.fetch_add(1, std::memory_order_relaxed);
+            if (sleepers.load(std::memory_order_relaxed))
+                ++wakeEpoch;
+        }
+        cv.notify_one();
+        return TaskFuture<R>(task, this);
+    }
+
+    // f() on a worker; the calling thread waits for it unless it is one
+    template <typename F>
+    auto run(F &&f) -> TaskResult<F>
+    {
+        if (onWorkerThread())
+            return f();
+        return submit(std::forward<F>(f)).get();
+    }
+
+    // runs a() and b(), possibly in parallel; an exception from either comes
+    // out of join once both are done
+    template <typename A, typename B>
+    void join(A &&a, B &&b)
+    {
+        Worker *self = currentWorker().pool == this ? currentWorker().worker : nullptr;
+        if (!self)
+            return run([&]
+                       { join(a, b); });
+
+        detail::Job job([&b]
+                        { b(); });
+        if (!self->deque.push(&job)) // deep enough: no more forking
+        {
+            a();
+            b();
+            return;
+        }
+        wakeOne();
+
+        std::exception_ptr error;
+        try
+        {
+            a();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        // whatever a() forked has been joined, so job is at the bottom
+        // unless it was stolen
+        if (self->deque.pop() == &job)
+            job.run();
+        else
+            while (!job.done.load(std::memory_order_acquire))
+                if (!runOne(*self, false))
+                    detail::cpuRelax();
+
+        if (error)
+            std::rethrow_exception(error);
+        if (job.error)
+            std::rethrow_exception(job.error);
+    }
+
+    // f(i) for every i in [first, last), in chunks of at least grain
+    template <typename Index, typename F>
+    void parallelFor(Index first, Index last, Index grain, F &&f)
+    {
+        if (first < last)
+            run([&]
+                { forRange(first, last, std::max<Index>(grain, 1), f); });
+    }
+
+    // reduce() over map(lo, hi) of chunks of at least grain in [first, last);
+    // identity for an empty range
+    template <typename Index, typename T, typename Map, typename Reduce>
+    T parallelReduce(Index first, Index last, Index grain, T identity, Map &&map, Reduce &&reduce)
+    {
+        if (!(first < last))
+            return identity;
+        return run([&]
+                   { return reduceRange(first, last, std::max<Index>(grain, 1), identity, map, reduce); });
+    }
+
+    // runs one pending job, if there is one; for threads waiting on a result
+    bool helpOnce()
+    {
+        Worker *self = currentWorker().pool == this ? currentWorker().worker : nullptr;
+        return self && runOne(*self, true);
+    }
+
+private:
+    struct Worker
+    {
+        explicit Worker(unsigned index) : index(index), rng(index * 0x9e3779b97f4a7c15ull + 1) {}
+
+        detail::WorkDeque deque;
+        const unsigned index;
+        std::uint64_t rng;
+        std::thread thread;
+    };
+
+    struct CurrentWorker
+    {
+        WorkStealingPool *pool;
+        Worker *worker;
+    };
+
+    // trivially constructible, so reaching it needs no initialization check
+    static CurrentWorker &currentWorker() noexcept
+    {
+        static thread_local CurrentWorker current{nullptr, nullptr};
+        return current;
+    }
+
+    template <typename Index, typename F>
+    void forRange(Index lo, Index hi, Index grain, F &f)
+    {
+        if (hi - lo <= grain)
+        {
+            for (Index i = lo; i != hi; ++i)
+                f(i);
+            return;
+        }
+        Index mid = lo + (hi - lo) / 2;
+        join([&]
+             { forRange(lo, mid, grain, f); },
+             [&]
+             { forRange(mid, hi, grain, f); });
+    }
+
+    template <typename Index, typename T, typename Map, typename Reduce>
+    T reduceRange(Index lo, Index hi, Index grain, const T &identity, Map &map, Reduce &reduce)
+    {
+        if (hi - lo <= grain)
+            return map(lo, hi);
+        Index mid = lo + (hi - lo) / 2;
+        T left = identity, right = identity;
+        join([&]
+             { left = reduceRange(lo, mid, grain, identity, map, reduce); },
+             [&]
+             { right = reduceRange(mid, hi, grain, identity, map, reduce); });
+        return reduce(std::move(left), std::move(right));
+    }
+
+    // own deque first, then (unless helping a join) the submitted tasks,
+    // then the other workers' deques starting at a random one
+    bool runOne(Worker &self, bool takeInjected)
+    {
+        if (detail::Job *job = self.deque.pop())
+        {
+            job->run();
+            return true;
+        }
+
+        if (takeInjected && injectedCount.load(std::memory_order_relaxed))
+        {
+            detail::Submitted *task;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                task = injectedHead;
+                if (task)
+                {
+                    injectedHead = task->next;
+                    if (!injectedHead)
+                        injectedTail = nullptr;
+                    injectedCount.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if (task)
+            {
+                task->run();
+                return true;
+            }
+        }
+
+        const std::size_t n = workers.size();
+        self.rng ^= self.rng << 13;
+        self.rng ^= self.rng >> 7;
+        self.rng ^= self.rng << 17;
+        for (std::size_t k = 0, start = self.rng % n; k != n; ++k)
+        {
+            Worker &victim = *workers[(start + k) % n];
+            if (&victim == &self)
+                continue;
+            if (detail::Job *job = victim.deque.steal())
+            {
+                job->run();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool anyWork() const
+    {
+        if (injectedHead)
+            return true;
+        for (const auto &w : workers)
+            if (!w->deque.empty())
+                return true;
+        return false;
+    }
+
+    // after a push to a deque: wake a sleeper, if any, to come and steal it
+    void wakeOne()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the sleeper's check
+        if (!sleepers.load(std::memory_order_relaxed))
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            ++wakeEpoch;
+        }
+        cv.notify_one();
+    }
+
+    void workerLoop(Worker &self)
+    {
+        currentWorker() = CurrentWorker{this, &self};
+
+        constexpr unsigned kPauses = 64, kYields = 256;
+        for (unsigned idle = 0;;)
+        {
+            if (runOne(self, true))
+            {
+                idle = 0;
+                continue;
+            }
+            if (++idle <= kPauses)
+            {
+                for (int i = 0; i != 16; ++i)
+                    detail::cpuRelax();
+                continue;
+            }
+            if (idle <= kPauses + kYields)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            idle = 0;
+
+            std::unique_lock<std::mutex> lock(m);
+            if (stopping && !injectedHead)
+                return;
+            std::uint64_t epoch = wakeEpoch;
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if (!anyWork())
+                cv.wait(lock, [&]
+                        { return wakeEpoch != epoch || stopping; });
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex m; // guards the injected queue, wakeEpoch and stopping
+    std::condition_variable cv;
+    detail::Submitted *injectedHead = nullptr; // submitted and not yet run, oldest first
+    detail::Submitted *injectedTail = nullptr;
+    std::atomic<std::size_t> injectedCount{0};
+    std::atomic<unsigned> sleepers{0};
+    std::uint64_t wakeEpoch = 0;
+    bool stopping = false;
+};
+
+template <typename R>
+void TaskFuture<R>::wait()
+{
+    if (pool && pool->onWorkerThread())
+        while (!ready())
+            if (!pool->helpOnce())
+                detail::cpuRelax();
+    task->wait();
+}
+
+// one pool for the whole program; never destroyed
+inline WorkStealingPool &sharedPool()
+{
+    static WorkStealingPool *pool = new WorkStealingPool();
+    return *pool;
+}